@@ -0,0 +1,494 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "builtin.h"
+#include "types.h"
+#include "array.h"
+#include "simd.h"
+
+#define F64(v) ((double *)(v)->d.arr->data)
+#define I64(v) ((long *)(v)->d.arr->data)
+
+// ---------- Create, Free ----------
+
+// Create storage for count elements of the given size. Elements are not initialized.
+array *array_new(int count, int size)
+{
+    array *a = malloc(sizeof(array));
+    a->refs = 1;
+    a->count = count;
+    a->data = malloc(count > 0 ? (size_t)count * size : 1);
+    return a;
+}
+
+// Release a reference. The storage is freed with its last reference.
+void array_free(array *a)
+{
+    if (__atomic_sub_fetch(&a->refs, 1, __ATOMIC_ACQ_REL) > 0)
+    {
+        return;
+    }
+
+    free(a->data);
+    free(a);
+}
+
+// Add a reference. Copying an Array value is O(1).
+array *array_share(array *a)
+{
+    __atomic_add_fetch(&a->refs, 1, __ATOMIC_RELAXED);
+    return a;
+}
+
+int is_array(val *v)
+{
+    return v->type == T_F64ARR || v->type == T_I64ARR;
+}
+
+// Convert an Integer Array to a Float Array. Takes ownership of the argument.
+static val *to_f64(val *v)
+{
+    if (v->type == T_F64ARR)
+    {
+        return v;
+    }
+
+    int n = v->d.arr->count;
+    val *r = new_array(T_F64ARR, n);
+
+    for (int i = 0; i < n; i++)
+    {
+        F64(r)[i] = I64(v)[i];
+    }
+
+    free_val(v);
+
+    return r;
+}
+
+// Check if a Number is zero, or an Array has a zero element.
+static int has_zero(val *v)
+{
+    if (v->type == T_INT || v->type == T_FLT)
+    {
+        return v->type == T_INT ? v->d.intg == 0 : v->d.flt == 0;
+    }
+
+    for (int i = 0; i < v->d.arr->count; i++)
+    {
+        if (v->type == T_F64ARR ? F64(v)[i] == 0 : I64(v)[i] == 0)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// ---------- Comparison, Hash ----------
+
+// Arrays of the same type are equal if they have the same length, and equal elements.
+int array_eq(val *x, val *y)
+{
+    int n = x->d.arr->count;
+
+    if (n != y->d.arr->count)
+    {
+        return 0;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        if (x->type == T_F64ARR ? F64(x)[i] != F64(y)[i] : I64(x)[i] != I64(y)[i])
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+unsigned long array_hash(val *v)
+{
+    unsigned long h = v->d.arr->count;
+
+    for (int i = 0; i < v->d.arr->count; i++)
+    {
+        unsigned long bits;
+
+        if (v->type == T_F64ARR)
+        {
+            // 0.0 and -0.0 are equal.
+            double f = F64(v)[i] == 0 ? 0 : F64(v)[i];
+            memcpy(&bits, &f, sizeof(bits));
+        }
+        else
+        {
+            bits = I64(v)[i];
+        }
+
+        h = (h ^ bits) * 1099511628211UL;
+    }
+
+    return h;
+}
+
+// ---------- Element ----------
+
+// Return element i as a Number.
+val *array_get(val *v, int i)
+{
+    return v->type == T_F64ARR ? new_flt(F64(v)[i]) : new_int(I64(v)[i]);
+}
+
+// ---------- Print ----------
+
+// Print as an Expression which creates the same Array: (f64-array {1.0 2.0}).
+char *array_to_str(val *v)
+{
+    char *prefix = v->type == T_F64ARR ? "(f64-array {" : "(i64-array {";
+    int len = strlen(prefix);
+    int cap = len + 16;
+    char *str = malloc(cap);
+    strcpy(str, prefix);
+
+    char item[512];
+
+    for (int i = 0; i < v->d.arr->count; i++)
+    {
+        int n;
+
+        if (v->type == T_F64ARR)
+        {
+            n = snprintf(item, sizeof(item), i ? " %f" : "%f", F64(v)[i]);
+        }
+        else
+        {
+            n = snprintf(item, sizeof(item), i ? " %ld" : "%ld", I64(v)[i]);
+        }
+
+        if (len + n + 3 > cap)
+        {
+            cap = (len + n + 3) * 2;
+            str = realloc(str, cap);
+        }
+
+        strcpy(str + len, item);
+        len += n;
+    }
+
+    strcpy(str + len, "})");
+
+    return str;
+}
+
+// ---------- Operations ----------
+
+// Element-wise operation on an Array, with Arrays of the same length or Numbers (used for every element).
+// If any Floats are present, the result is a Float Array. No limit on the number of arguments.
+// Accepts operations: '+', '-', '*', '/'.
+val *array_operation(val *v, char *op)
+{
+    ASSERT_MIN(op, v, 2);
+
+    for (int i = 1; i < v->d.exp.count; i++)
+    {
+        val *y = v->d.exp.list[i];
+
+        ASSERT(v, is_array(y) || y->type == T_INT || y->type == T_FLT,
+            "Function '%s' passed incorrect type for argument %i. Got %s, Expected Number or Array.", op, i, type_name(y->type));
+        ASSERT(v, !is_array(y) || y->d.arr->count == v->d.exp.list[0]->d.arr->count,
+            "Function '%s' passed Arrays of different lengths (%i and %i).", op, v->d.exp.list[0]->d.arr->count, y->d.arr->count);
+    }
+
+    simd_op o = op[0] == '+' ? OP_ADD : op[0] == '-' ? OP_SUB : op[0] == '*' ? OP_MUL : OP_DIV;
+
+    val *x = exp_pop(v, 0);
+    int n = x->d.arr->count;
+
+    while (v->d.exp.count > 0)
+    {
+        val *y = exp_pop(v, 0);
+        val *r;
+
+        // Same as for Numbers, division by zero is an error, also for Floats.
+        if (o == OP_DIV && has_zero(y))
+        {
+            free_val(x);
+            free_val(y);
+            x = new_err("Division By Zero.");
+            break;
+        }
+
+        if (x->type == T_F64ARR || y->type == T_F64ARR || y->type == T_FLT)
+        {
+            x = to_f64(x);
+            if (is_array(y))
+            {
+                y = to_f64(y);
+            }
+
+            r = new_array(T_F64ARR, n);
+            f64_op(o, F64(r), F64(x), is_array(y) ? F64(y) : NULL, y->type == T_FLT ? y->d.flt : y->d.intg, n);
+        }
+        else
+        {
+            r = new_array(T_I64ARR, n);
+            i64_op(o, I64(r), I64(x), is_array(y) ? I64(y) : NULL, y->type == T_INT ? y->d.intg : 0, n);
+        }
+
+        free_val(x);
+        free_val(y);
+        x = r;
+    }
+
+    free_val(v);
+    return x;
+}
+
+// Convert a List of Numbers, or an Array, to an Array of the given type.
+static val *array_from(val *v, val_t type, char *func)
+{
+    ASSERT_NUM(func, v, 1);
+
+    val *x = v->d.exp.list[0];
+
+    ASSERT(v, x->type == T_LST || is_array(x),
+        "Function '%s' passed incorrect type for argument 0. Got %s, Expected List or Array.", func, type_name(x->type));
+
+    if (x->type == type)
+    {
+        return exp_take(v, 0);
+    }
+
+    int n = is_array(x) ? x->d.arr->count : x->d.exp.count;
+    val *r = new_array(type, n);
+
+    for (int i = 0; i < n; i++)
+    {
+        double f;
+        long l;
+
+        if (x->type == T_F64ARR)
+        {
+            f = F64(x)[i];
+            l = F64(x)[i];
+        }
+        else if (x->type == T_I64ARR)
+        {
+            f = I64(x)[i];
+            l = I64(x)[i];
+        }
+        else if (x->d.exp.list[i]->type == T_INT)
+        {
+            f = x->d.exp.list[i]->d.intg;
+            l = x->d.exp.list[i]->d.intg;
+        }
+        else if (x->d.exp.list[i]->type == T_FLT)
+        {
+            f = x->d.exp.list[i]->d.flt;
+            l = x->d.exp.list[i]->d.flt;
+        }
+        else
+        {
+            val *err = new_err("Function '%s' passed incorrect type for element %i of argument 0. Got %s, Expected Number.",
+                func, i, type_name(x->d.exp.list[i]->type));
+            free_val(r);
+            free_val(v);
+            return err;
+        }
+
+        if (type == T_F64ARR)
+        {
+            F64(r)[i] = f;
+        }
+        else
+        {
+            I64(r)[i] = l;
+        }
+    }
+
+    free_val(v);
+
+    return r;
+}
+
+// ---------- Builtins ----------
+
+// Create a Float Array. Accepts a List of Numbers, or an Array.
+val *b_f64_array(env *e, val *v)
+{
+    return array_from(v, T_F64ARR, "f64-array");
+}
+
+// Create an Integer Array. Accepts a List of Numbers, or an Array. Floats are truncated.
+val *b_i64_array(env *e, val *v)
+{
+    return array_from(v, T_I64ARR, "i64-array");
+}
+
+// Convert an Array to a List of Numbers.
+val *b_array_list(env *e, val *v)
+{
+    ASSERT_NUM("array-list", v, 1);
+    ASSERT_ARRAY_TYPE("array-list", v, 0);
+
+    val *x = v->d.exp.list[0];
+    val *l = new_lst();
+
+    exp_reserve(l, x->d.arr->count);
+    l->d.exp.count = x->d.arr->count;
+
+    for (int i = 0; i < l->d.exp.count; i++)
+    {
+        l->d.exp.list[i] = array_get(x, i);
+    }
+
+    free_val(v);
+
+    return l;
+}
+
+// Return the sum of the elements of an Array.
+val *b_array_sum(env *e, val *v)
+{
+    ASSERT_NUM("array-sum", v, 1);
+    ASSERT_ARRAY_TYPE("array-sum", v, 0);
+
+    val *x = v->d.exp.list[0];
+    val *r = x->type == T_F64ARR ? new_flt(f64_sum(F64(x), x->d.arr->count)) : new_int(i64_sum(I64(x), x->d.arr->count));
+
+    free_val(v);
+
+    return r;
+}
+
+// Return the dot product of two Arrays of the same length.
+val *b_array_dot(env *e, val *v)
+{
+    ASSERT_NUM("array-dot", v, 2);
+    ASSERT_ARRAY_TYPE("array-dot", v, 0);
+    ASSERT_ARRAY_TYPE("array-dot", v, 1);
+    ASSERT(v, v->d.exp.list[0]->d.arr->count == v->d.exp.list[1]->d.arr->count,
+        "Function 'array-dot' passed Arrays of different lengths (%i and %i).", v->d.exp.list[0]->d.arr->count, v->d.exp.list[1]->d.arr->count);
+
+    val *x = exp_pop(v, 0);
+    val *y = exp_take(v, 0);
+    val *r;
+
+    if (x->type == T_F64ARR || y->type == T_F64ARR)
+    {
+        x = to_f64(x);
+        y = to_f64(y);
+        r = new_flt(f64_dot(F64(x), F64(y), x->d.arr->count));
+    }
+    else
+    {
+        r = new_int(i64_dot(I64(x), I64(y), x->d.arr->count));
+    }
+
+    free_val(x);
+    free_val(y);
+
+    return r;
+}
+
+// Minimum or maximum element of a non-empty Array.
+static val *array_minmax(val *v, int max, char *func)
+{
+    ASSERT_NUM(func, v, 1);
+    ASSERT_ARRAY_TYPE(func, v, 0);
+    ASSERT(v, v->d.exp.list[0]->d.arr->count > 0, "Function '%s' passed an empty Array.", func);
+
+    val *x = v->d.exp.list[0];
+    int n = x->d.arr->count;
+    val *r;
+
+    if (x->type == T_F64ARR)
+    {
+        r = new_flt(max ? f64_max(F64(x), n) : f64_min(F64(x), n));
+    }
+    else
+    {
+        r = new_int(max ? i64_max(I64(x), n) : i64_min(I64(x), n));
+    }
+
+    free_val(v);
+
+    return r;
+}
+
+val *b_array_min(env *e, val *v)
+{
+    return array_minmax(v, 0, "array-min");
+}
+
+val *b_array_max(env *e, val *v)
+{
+    return array_minmax(v, 1, "array-max");
+}
+
+// Multiply every element of an Array by a Number.
+val *b_array_scale(env *e, val *v)
+{
+    ASSERT_NUM("array-scale", v, 2);
+    ASSERT_ARRAY_TYPE("array-scale", v, 0);
+    ASSERT_NUM_TYPE("array-scale", v, 1);
+
+    return array_operation(v, "*");
+}
+
+// Compare an Array element-wise with an Array of the same length or a Number, and return an Integer Array of 1 (true) or 0 (false).
+// Accepts a String operator ('<', '<=', '>', '>=', '==', '!='), an Array, and an Array or a Number.
+val *b_array_cmp(env *e, val *v)
+{
+    ASSERT_NUM("array-cmp", v, 3);
+    ASSERT_TYPE("array-cmp", v, 0, T_STR);
+    ASSERT_ARRAY_TYPE("array-cmp", v, 1);
+
+    static const char *ops[] = {"<", "<=", ">", ">=", "==", "!="};
+    static const simd_cmp cmps[] = {CMP_LT, CMP_LE, CMP_GT, CMP_GE, CMP_EQ, CMP_NE};
+
+    int c = -1;
+    for (int i = 0; i < 6; i++)
+    {
+        if (strcmp(v->d.exp.list[0]->d.str, ops[i]) == 0)
+        {
+            c = i;
+        }
+    }
+
+    ASSERT(v, c != -1, "Function 'array-cmp' passed unknown operator '%s'. Expected <, <=, >, >=, == or !=.", v->d.exp.list[0]->d.str);
+
+    val *y = v->d.exp.list[2];
+    ASSERT(v, is_array(y) || y->type == T_INT || y->type == T_FLT,
+        "Function 'array-cmp' passed incorrect type for argument 2. Got %s, Expected Number or Array.", type_name(y->type));
+    ASSERT(v, !is_array(y) || y->d.arr->count == v->d.exp.list[1]->d.arr->count,
+        "Function 'array-cmp' passed Arrays of different lengths (%i and %i).", v->d.exp.list[1]->d.arr->count, y->d.arr->count);
+
+    val *x = exp_pop(v, 1);
+    y = exp_pop(v, 1);
+    int n = x->d.arr->count;
+    val *r = new_array(T_I64ARR, n);
+
+    if (x->type == T_F64ARR || y->type == T_F64ARR || y->type == T_FLT)
+    {
+        x = to_f64(x);
+        if (is_array(y))
+        {
+            y = to_f64(y);
+        }
+
+        f64_cmp(cmps[c], I64(r), F64(x), is_array(y) ? F64(y) : NULL, y->type == T_FLT ? y->d.flt : y->d.intg, n);
+    }
+    else
+    {
+        i64_cmp(cmps[c], I64(r), I64(x), is_array(y) ? I64(y) : NULL, y->type == T_INT ? y->d.intg : 0, n);
+    }
+
+    free_val(x);
+    free_val(y);
+    free_val(v);
+
+    return r;
+}
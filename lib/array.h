@@ -0,0 +1,64 @@
+#ifndef ARRAY_H
+#define ARRAY_H
+
+#include "types.h"
+
+// Contiguous Float (double) or Integer (long) elements. Arrays are never changed after being filled,
+// so copies of an Array value share the same storage.
+struct array
+{
+    int refs;
+    int count;
+
+    void *data;
+};
+
+// ---------- Create, Free ----------
+
+array *array_new(int count, int size);
+
+void array_free(array *a);
+
+array *array_share(array *a);
+
+int is_array(val *v);
+
+// ---------- Comparison, Hash ----------
+
+int array_eq(val *x, val *y);
+
+unsigned long array_hash(val *v);
+
+// ---------- Element ----------
+
+val *array_get(val *v, int i);
+
+// ---------- Print ----------
+
+char *array_to_str(val *v);
+
+// ---------- Operations ----------
+
+val *array_operation(val *v, char *op);
+
+// ---------- Builtins ----------
+
+val *b_f64_array(env *e, val *v);
+
+val *b_i64_array(env *e, val *v);
+
+val *b_array_list(env *e, val *v);
+
+val *b_array_sum(env *e, val *v);
+
+val *b_array_dot(env *e, val *v);
+
+val *b_array_min(env *e, val *v);
+
+val *b_array_max(env *e, val *v);
+
+val *b_array_scale(env *e, val *v);
+
+val *b_array_cmp(env *e, val *v);
+
+#endif
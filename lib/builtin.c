@@ -1,74 +1,59 @@
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include <limits.h>
+#include <pthread.h>
 
 #include "mpc.h"
 
 #include "builtin.h"
 #include "types.h"
 #include "parser.h"
-
-// Assert condition is true, otherwise return error and free argument.
-#define ASSERT(args, cond, format, ...)            \
-    if (!(cond))                                   \
-    {                                              \
-        val *err = new_err(format, ##__VA_ARGS__); \
-        free_val(args);                            \
-        return err;                                \
-    }
-
-// Assert type of argument is correct.
-#define ASSERT_TYPE(func, args, index, expect) \
-  ASSERT(args, args->d.exp.list[index]->type == expect, \
-    "Function '%s' passed incorrect type for argument %i. Got %s, Expected %s.", \
-    func, index, type_name(args->d.exp.list[index]->type), type_name(expect))
-
-// Assert number of arguments is correct.
-#define ASSERT_NUM(func, args, num) \
-  ASSERT(args, args->d.exp.count == num, \
-    "Function '%s' passed incorrect number of arguments. Got %i, Expected %i.", \
-    func, args->d.exp.count, num)
-
-// Assert minimum number of arguments.
-#define ASSERT_MIN(func, args, num) \
-  ASSERT(args, args->d.exp.count >= num, \
-    "Function '%s' passed incorrect number of arguments. Got %i, Expected at least %i.", \
-    func, args->d.exp.count, num)
-
-// Assert argument is not empty.
-#define ASSERT_NOT_EMPTY(func, args, index) \
-  ASSERT(args, args->d.exp.list[index]->d.exp.count != 0, \
-    "Function '%s' passed {} for argument %i.", func, index);
-
-// Assert argument is empty.
-#define ASSERT_EMPTY(func, args, index) \
-  ASSERT(args, args->d.exp.list[index]->d.exp.count == 0, \
-    "Function '%s' passed non-empty for argument %i. Expected {}.", func, index);
-
-// Assert type of argument element is correct.
-#define ASSERT_ELEM_TYPE(func, args, index, elem, expect) \
-  ASSERT(args, args->d.exp.list[index]->d.exp.list[elem]->type == expect, \
-    "Function '%s' passed incorrect type for element %i of argument %i. Got %s, Expected %s.", \
-    func, elem, index, type_name(args->d.exp.list[index]->d.exp.list[elem]->type), type_name(expect))
-
-// Assert type of argument is Number.
-#define ASSERT_NUM_TYPE(func, args, index) \
-  ASSERT(args, v->d.exp.list[index]->type == T_INT || v->d.exp.list[index]->type == T_FLT, \
-    "Function '%s' passed incorrect type for argument %i. Got %s, Expected Number.", func, index, type_name(v->d.exp.list[index]->type));
-
-// Assert type of argument is Number or String.
-#define ASSERT_NUM_STR_TYPE(func, args, index) \
-  ASSERT(args, v->d.exp.list[index]->type == T_INT || v->d.exp.list[index]->type == T_FLT || v->d.exp.list[index]->type == T_STR, \
-    "Function '%s' passed incorrect type for argument %i. Got %s, Expected Number or String.", func, index, type_name(v->d.exp.list[index]->type));
-
-extern mpc_parser_t *Parser;
-
-// Return the element i of a List.
+#include "interp.h"
+#include "parallel.h"
+#include "map.h"
+#include "array.h"
+#include "sort.h"
+#include "seq.h"
+#include "bytes.h"
+#include "file.h"
+#include "csv.h"
+#include "json.h"
+#include "prof.h"
+#include "optimize.h"
+
+// Return the element i of a List, an Array, or a Sequence.
 val *b_get(env *e, val *v)
 {
     ASSERT_NUM("get", v, 2);
-    ASSERT_TYPE("get", v, 0, T_LST);
     ASSERT_TYPE("get", v, 1, T_INT);
 
+    if (v->d.exp.list[0]->type == T_SEQ)
+    {
+        long i = v->d.exp.list[1]->d.intg;
+        val *x = i >= 0 ? seq_get(v->d.exp.list[0]->d.seq, e, i) : NULL;
+
+        ASSERT(v, x, "Function 'get' index out of bounds (index: %li).", i);
+
+        free_val(v);
+        return x;
+    }
+
+    if (is_array(v->d.exp.list[0]))
+    {
+        val *a = v->d.exp.list[0];
+        long i = v->d.exp.list[1]->d.intg;
+
+        ASSERT(v, i >= 0 && i < a->d.arr->count,
+            "Function 'get' index out of bounds (index: %li, array length: %i).", i, a->d.arr->count);
+
+        val *x = array_get(a, i);
+        free_val(v);
+        return x;
+    }
+
+    ASSERT_TYPE("get", v, 0, T_LST);
+
     ASSERT(v, v->d.exp.list[0]->d.exp.count > v->d.exp.list[1]->d.intg, 
         "Function 'get' index out of bounds (index: %i, list length: %i).", v->d.exp.list[1]->d.intg, v->d.exp.list[0]->d.exp.count);
 
@@ -120,10 +105,32 @@ val *b_eval(env *e, val *v)
     return eval(e, l);
 }
 
-// Return the length of a List.
+// Return the length of a List, an Array, a Sequence, or Bytes.
 val *b_len(env *e, val *v)
 {
     ASSERT_NUM("len", v, 1);
+
+    if (v->d.exp.list[0]->type == T_BYTES)
+    {
+        val *len = new_int(v->d.exp.list[0]->d.bytes.len);
+        free_val(v);
+        return len;
+    }
+
+    if (v->d.exp.list[0]->type == T_SEQ)
+    {
+        val *len = seq_len(v->d.exp.list[0]->d.seq, e);
+        free_val(v);
+        return len;
+    }
+
+    if (is_array(v->d.exp.list[0]))
+    {
+        val *len = new_int(v->d.exp.list[0]->d.arr->count);
+        free_val(v);
+        return len;
+    }
+
     ASSERT_TYPE("len", v, 0, T_LST);
 
     val *l = exp_take(v, 0);
@@ -132,23 +139,10 @@ val *b_len(env *e, val *v)
     return len;
 }
 
-// Check if Symbol is a reserved keyword.
-int check_reserved(char* sym){
-    
-    static const char *keywords[] = {
-        "==", "!", "error", "print", "load", "if", "<", ">", "||", "&&", "len", "+", "-", "*", "/", "%", "^", 
-        "def", "env", "list", "get", "remove", "eval", "exit", "fun", "=", "typeof", "string", "int", "float"
-    };
-
-    static int num_keywords = sizeof(keywords) / sizeof(keywords[0]);
-
-    for (int i = 0; i < num_keywords; i++) {
-        if (strcmp(sym, keywords[i]) == 0) {
-            return 1;
-        }
-    }
-
-    return 0;
+// Check if Symbol is a reserved keyword: the Symbol of a builtin.
+int check_reserved(char *sym)
+{
+    return builtin_symbol(sym) != NULL;
 }
 
 // Define a variable in an environment. Accepts a List of Symbols, followed by values.
@@ -172,6 +166,13 @@ val *def_var(env *e, val *v, char *op)
 
     for (int i = 0; i < keys->d.exp.count; i++)
     {
+#ifdef ZLISP_PROFILE
+        if (prof_enabled && v->d.exp.list[i + 1]->type == T_FUN)
+        {
+            prof_label_fun(v->d.exp.list[i + 1], keys->d.exp.list[i]->d.str);
+        }
+#endif
+
         if (strcmp(op, "def") == 0)
         {
             env_set_global(e, keys->d.exp.list[i], v->d.exp.list[i + 1]);
@@ -229,6 +230,17 @@ val *b_exit(env *e, val *v)
     exit(EXIT_SUCCESS);
 }
 
+// Return memory statistics of the interpreter as a List of {name value} pairs. Accepts {}.
+val *b_mem_stats(env *e, val *v)
+{
+    ASSERT_NUM("mem-stats", v, 1);
+    ASSERT_EMPTY("mem-stats", v, 0);
+
+    free_val(v);
+
+    return stats_list(&env_interp(e)->stats);
+}
+
 // Create a function. Accepts a List of Symbols as header, followed by a List as body.
 val *b_fun(env *e, val *v)
 {
@@ -248,7 +260,16 @@ val *b_fun(env *e, val *v)
     val *body = exp_pop(v, 0);
     free_val(v);
 
-    return new_fun(header, body);
+    val *f = new_fun(header, body);
+
+#ifdef ZLISP_PROFILE
+    if (prof_enabled)
+    {
+        prof_name_fun(f);
+    }
+#endif
+
+    return f;
 }
 
 // If statement. Accepts a Number, and two Lists. Evaluate first if Number is true, otherwise evaluate second.
@@ -269,58 +290,124 @@ val *b_if(env *e, val *v)
     }
 }
 
+// Run all top-level Components of a file in an environment. Returns () or Error if failed.
+val *run_file(env *e, char *path)
+{
+    interp *ip = env_interp(e);
+    val *exp = parse_file(path, ip->parser);
+
+    if (exp->type == T_ERR)
+    {
+        return exp;
+    }
+
+    optimizer *o = new_optimizer(exp);
+
+    while (exp->d.exp.count)
+    {
+        val *x = eval(e, optimize(o, e, exp_pop(exp, 0)));
+
+        if (x->type == T_ERR)
+        {
+            fprint_val_ln(ip->out, x);
+        }
+
+        free_val(x);
+    }
+
+    free_optimizer(o);
+    free_val(exp);
+
+    return new_exp();
+}
+
 // Load/run a Z-Lisp file. Accepts a String as a file name. Returns () or Error if failed.
 val *b_load(env *e, val *v)
 {
     ASSERT_NUM("load", v, 1);
     ASSERT_TYPE("load", v, 0, T_STR);
 
-    mpc_result_t r;
-    if (mpc_parse_contents(v->d.exp.list[0]->d.str, Parser, &r))
-    {
-        val *exp = parse_node(r.output);
-        mpc_ast_delete(r.output);
+    val *r = run_file(e, v->d.exp.list[0]->d.str);
+    free_val(v);
 
-        while (exp->d.exp.count)
-        {
-            val *x = eval(e, exp_pop(exp, 0));
+    return r;
+}
 
-            if (x->type == T_ERR)
-            {
-                print_val_ln(x);
-            }
+// Load a Z-Lisp file as a Module, once per process. Accepts a String as a file name.
+// Returns the Module, whose definitions are accessed as 'module/name', or Error if failed.
+val *b_require(env *e, val *v)
+{
+    ASSERT_NUM("require", v, 1);
+    ASSERT_TYPE("require", v, 0, T_STR);
 
-            free_val(x);
-        }
+    char *path = canonical_path(v->d.exp.list[0]->d.str);
 
-        free_val(exp);
-        free_val(v);
+    ASSERT(v, path, "Failed to load module: Unable to open file '%s'.", v->d.exp.list[0]->d.str);
 
-        return new_exp();
-    }
-    else
+    free_val(v);
+
+    interp *ip = env_interp(e);
+
+    // Already loaded (or being loaded, in case of circular requires).
+    for (int i = 0; i < ip->module_count; i++)
     {
-        char *err_msg = mpc_err_string(r.error);
-        mpc_err_delete(r.error);
+        if (strcmp(ip->module_paths[i], path) == 0)
+        {
+            val *m = new_mod(path, ip->module_envs[i]);
+            free(path);
+            return m;
+        }
+    }
 
-        val *err = new_err("Failed to load library: %s", err_msg);
-        free(err_msg);
-        free_val(v);
+    // Module environment sees the global environment, but keeps its own definitions.
+    env *me = new_env();
+    me->parent = ip->env;
+    me->module = 1;
+
+    ip->module_count++;
+    ip->module_paths = realloc(ip->module_paths, ip->module_count * sizeof(char *));
+    ip->module_envs = realloc(ip->module_envs, ip->module_count * sizeof(env *));
+    ip->module_paths[ip->module_count - 1] = path;
+    ip->module_envs[ip->module_count - 1] = me;
 
-        return err;
+    val *r = run_file(me, path);
+
+    // Only fails when parsing, before anything else could be registered.
+    if (r->type == T_ERR)
+    {
+        ip->module_count--;
+        free_env(me);
+        free(path);
+        return r;
     }
+
+    free_val(r);
+
+    return new_mod(path, me);
 }
 
-// Print arguments separated by a space, followed by a newline to stdout.
+// Print arguments separated by a space, followed by a newline to the interpreter's output.
 val *b_print(env *e, val *v)
 {
+    FILE *out = env_interp(e)->out;
+
+    for (int i = 0; i < v->d.exp.count; i++)
+    {
+        v->d.exp.list[i] = seq_force(v->d.exp.list[i], e);
+
+        if (v->d.exp.list[i]->type == T_ERR)
+        {
+            return exp_take(v, i);
+        }
+    }
+
     for (int i = 0; i < v->d.exp.count; i++)
     {
-        print_val(v->d.exp.list[i]);
-        putchar(' ');
+        fprint_val(out, v->d.exp.list[i]);
+        fputc(' ', out);
     }
 
-    putchar('\n');
+    fputc('\n', out);
     free_val(v);
 
     return new_exp();
@@ -380,6 +467,7 @@ val *num_operation(val *v, char *op)
     {
         if (v->d.exp.list[i]->type == T_FLT)
         {
+            exp_own(v);
             for (int j = 0; j < v->d.exp.count; j++)
             {
                 if (v->d.exp.list[j]->type == T_INT)
@@ -454,9 +542,10 @@ val *num_math(val* v, char* op){
                 break;
             }
 
+            // LONG_MIN / -1 overflows, and traps on most machines, so it wraps like the other operators.
             if (x->type == T_INT)
             {
-                x->d.intg /= y->d.intg;
+                x->d.intg = y->d.intg == -1 ? (long)(0UL - (unsigned long)x->d.intg) : x->d.intg / y->d.intg;
             }
             else if (x->type == T_FLT)
             {
@@ -465,9 +554,17 @@ val *num_math(val* v, char* op){
         }
         else if (strcmp(op, "%") == 0)
         {
+            if (y->d.intg == 0)
+            {
+                free_val(x);
+                free_val(y);
+                x = new_err("Division By Zero.");
+                break;
+            }
+
             if (x->type == T_INT)
             {
-                x->d.intg %= y->d.intg;
+                x->d.intg = y->d.intg == -1 ? 0 : x->d.intg % y->d.intg;
             }
             else if (x->type == T_FLT)
             {
@@ -621,14 +718,12 @@ val *str_concat(val *v)
 
         if (x->type == T_STR)
         {
-            s->d.str = realloc(s->d.str, strlen(s->d.str) + strlen(x->d.str) + 1);
-            strcat(s->d.str, x->d.str);
+            str_append(s, x->d.str);
         }
         else
         {
             char *str = val_to_str(x);
-            s->d.str = realloc(s->d.str, strlen(s->d.str) + strlen(str) + 1);
-            strcat(s->d.str, str);
+            str_append(s, str);
             free(str);
         }
 
@@ -643,6 +738,7 @@ val *str_concat(val *v)
 // Method of addition depends on the type of the first argument.
 // If the first argument is a String, all arguments will be concatenated, and non-Strings will be converted.
 // If the first argument is a List, all arguments will be joined. If any argument is not a List, it will be added to the List.
+// If the first argument is an Array, arguments will be added element-wise.
 // If the first argument is a Number, all arguments will be added together. If any argument is not a Number, it will throw an error.
 val *b_add(env *e, val *v)
 {
@@ -652,6 +748,8 @@ val *b_add(env *e, val *v)
         return str_concat(v);
     } else if (v->d.exp.list[0]->type == T_LST) {
         return join(v);
+    } else if (is_array(v->d.exp.list[0])) {
+        return array_operation(v, "+");
     } else {
         return num_operation(v, "+");
     }
@@ -662,6 +760,11 @@ val *b_add(env *e, val *v)
 val *b_sub(env *e, val *v)
 {
     // Special case for unary minus
+    if (v->d.exp.count == 1 && is_array(v->d.exp.list[0]))
+    {
+        exp_add(v, new_int(-1));
+        return array_operation(v, "*");
+    }
     if (v->d.exp.count == 1)
     {
         ASSERT_NUM_TYPE("-", v, 0);
@@ -680,16 +783,31 @@ val *b_sub(env *e, val *v)
         return x;
     }
 
+    if (v->d.exp.count && is_array(v->d.exp.list[0]))
+    {
+        return array_operation(v, "-");
+    }
+
     return num_operation(v, "-");
 }
 
 val *b_mul(env *e, val *v)
 {
+    if (v->d.exp.count && is_array(v->d.exp.list[0]))
+    {
+        return array_operation(v, "*");
+    }
+
     return num_operation(v, "*");
 }
 
 val *b_div(env *e, val *v)
 {
+    if (v->d.exp.count && is_array(v->d.exp.list[0]))
+    {
+        return array_operation(v, "/");
+    }
+
     return num_operation(v, "/");
 }
 
@@ -739,7 +857,16 @@ val *b_string(env *e, val *v)
 {
     ASSERT_NUM("string", v, 1);
 
-    val *str = new_str(val_to_str(v->d.exp.list[0]));
+    v->d.exp.list[0] = seq_force(v->d.exp.list[0], e);
+
+    if (v->d.exp.list[0]->type == T_ERR)
+    {
+        return exp_take(v, 0);
+    }
+
+    char *text = val_to_str(v->d.exp.list[0]);
+    val *str = new_str(text);
+    free(text);
     free_val(v);
 
     return str;
@@ -805,164 +932,214 @@ void add_builtin(env *e, char *key, builtin blt)
     free_val(val);
 }
 
-// Register all builtin functions in the environment.
-void add_builtins(env *e)
+// ---------- Registry ----------
+
+// Slots of each perfect hash table of the registry. A power of two, a dozen times the number of builtins, so a seed
+// without collisions is found in a few tries.
+#define REGISTRY_SLOTS 1024
+
+// Builtin functions: the Symbol each is defined as, the function, its name when printed or profiled, the least and
+// most arguments (-1 for any number), and flags. The arities document each builtin, and are not checked here:
+// builtins check their own arguments, so their errors say what was expected of each.
+static builtin_info registry[] = {
+    {"list", b_list, "builtin_list", 0, -1, BLT_PURE},
+    {"get", b_get, "builtin_get", 2, 2, BLT_PURE},
+    {"remove", b_remove, "builtin_remove", 2, 2, BLT_PURE},
+    {"eval", b_eval, "builtin_eval", 1, 1, 0},
+    {"+", b_add, "builtin_add", 2, -1, BLT_FOLD},
+    {"-", b_sub, "builtin_sub", 1, -1, BLT_FOLD},
+    {"*", b_mul, "builtin_mul", 2, -1, BLT_FOLD},
+    {"/", b_div, "builtin_div", 2, -1, BLT_FOLD},
+    {"%", b_mod, "builtin_mod", 2, -1, BLT_FOLD},
+    {"^", b_pow, "builtin_pow", 2, -1, BLT_FOLD},
+    {"def", b_def, "builtin_def", 1, -1, 0},
+    {"=", b_put, "builtin_put", 1, -1, 0},
+    {"env", b_env, "builtin_env", 1, 1, 0},
+    {"exit", b_exit, "builtin_exit", 1, 1, 0},
+    {"fun", b_fun, "builtin_fun", 2, 2, 0},
+    {"len", b_len, "builtin_len", 1, 1, BLT_PURE},
+    {">", b_gt, "builtin_gt", 2, -1, BLT_FOLD},
+    {"<", b_lt, "builtin_lt", 2, -1, BLT_FOLD},
+    {"||", b_or, "builtin_or", 2, -1, BLT_FOLD},
+    {"&&", b_and, "builtin_and", 2, -1, BLT_FOLD},
+    {"==", b_eq, "builtin_eq", 2, 2, BLT_FOLD},
+    {"!", b_not, "builtin_not", 1, 1, BLT_FOLD},
+    {"if", b_if, "builtin_if", 3, 3, 0},
+    {"load", b_load, "builtin_load", 1, 1, 0},
+    {"require", b_require, "builtin_require", 1, 1, 0},
+    {"print", b_print, "builtin_print", 0, -1, 0},
+    {"error", b_error, "builtin_error", 1, 1, 0},
+    {"typeof", b_typeof, "builtin_typeof", 1, 1, BLT_PURE},
+    {"string", b_string, "builtin_string", 1, 1, BLT_PURE},
+    {"int", b_int, "builtin_int", 1, 1, BLT_PURE},
+    {"float", b_float, "builtin_float", 1, 1, BLT_PURE},
+    {"pmap", b_pmap, "builtin_pmap", 2, 2, 0},
+    {"pfilter", b_pfilter, "builtin_pfilter", 2, 2, 0},
+    {"preduce", b_preduce, "builtin_preduce", 3, 3, 0},
+    {"map-new", b_map_new, "builtin_map_new", 0, -1, 0},
+    {"map-get", b_map_get, "builtin_map_get", 2, 3, BLT_PURE},
+    {"map-has", b_map_has, "builtin_map_has", 2, 2, BLT_PURE},
+    {"map-put", b_map_put, "builtin_map_put", 3, -1, 0},
+    {"map-del", b_map_del, "builtin_map_del", 2, -1, 0},
+    {"map-keys", b_map_keys, "builtin_map_keys", 1, 1, 0},
+    {"map-len", b_map_len, "builtin_map_len", 1, 1, BLT_PURE},
+    {"f64-array", b_f64_array, "builtin_f64_array", 1, 1, 0},
+    {"i64-array", b_i64_array, "builtin_i64_array", 1, 1, 0},
+    {"array-list", b_array_list, "builtin_array_list", 1, 1, 0},
+    {"array-sum", b_array_sum, "builtin_array_sum", 1, 1, 0},
+    {"array-dot", b_array_dot, "builtin_array_dot", 2, 2, 0},
+    {"array-min", b_array_min, "builtin_array_min", 1, 1, 0},
+    {"array-max", b_array_max, "builtin_array_max", 1, 1, 0},
+    {"array-scale", b_array_scale, "builtin_array_scale", 2, 2, 0},
+    {"array-cmp", b_array_cmp, "builtin_array_cmp", 3, 3, 0},
+    {"sort", b_sort, "builtin_sort", 1, 2, 0},
+    {"range", b_range, "builtin_range", 1, 3, 0},
+    {"seq-map", b_seq_map, "builtin_seq_map", 2, 2, 0},
+    {"seq-filter", b_seq_filter, "builtin_seq_filter", 2, 2, 0},
+    {"seq-take", b_seq_take, "builtin_seq_take", 2, 2, 0},
+    {"seq-drop", b_seq_drop, "builtin_seq_drop", 2, 2, 0},
+    {"seq-foldl", b_seq_foldl, "builtin_seq_foldl", 3, 3, 0},
+    {"seq-list", b_seq_list, "builtin_seq_list", 1, 1, 0},
+    {"bytes", b_bytes, "builtin_bytes", 1, 1, 0},
+    {"slice", b_slice, "builtin_slice", 2, 3, 0},
+    {"bytes-get", b_bytes_get, "builtin_bytes_get", 2, 2, 0},
+    {"bytes-set", b_bytes_set, "builtin_bytes_set", 3, 3, 0},
+    {"read-bytes", b_read_bytes, "builtin_read_bytes", 1, 1, 0},
+    {"bytes-hex", b_bytes_hex, "builtin_bytes_hex", 1, 1, 0},
+    {"hex-bytes", b_hex_bytes, "builtin_hex_bytes", 1, 1, 0},
+    {"open", b_open, "builtin_open", 1, 2, 0},
+    {"close", b_close, "builtin_close", 1, 1, 0},
+    {"read-line", b_read_line, "builtin_read_line", 1, 1, 0},
+    {"write", b_write, "builtin_write", 2, -1, 0},
+    {"lines", b_lines, "builtin_lines", 1, 1, 0},
+    {"read-csv", b_read_csv, "builtin_read_csv", 1, 2, 0},
+    {"json-parse", b_json_parse, "builtin_json_parse", 1, 1, 0},
+    {"json-dump", b_json_dump, "builtin_json_dump", 1, 1, 0},
+    {"mem-stats", b_mem_stats, "builtin_mem_stats", 1, 1, 0},
+};
+
+#define REGISTRY_COUNT ((int)(sizeof(registry) / sizeof(registry[0])))
+
+// The tables below store an entry plus one in an unsigned char, so fail to compile if the registry outgrows it.
+typedef char registry_fits_slots[REGISTRY_COUNT < 255 ? 1 : -1];
+
+// Entries of the registry by hash of Symbol, and by hash of function, plus one (0 for empty slots). The seeds make
+// each hash perfect: no two entries share a slot, so a lookup compares one entry.
+static unsigned char by_symbol[REGISTRY_SLOTS];
+static unsigned char by_fun[REGISTRY_SLOTS];
+static unsigned long symbol_seed;
+static unsigned long fun_seed;
+
+static pthread_once_t registry_once = PTHREAD_ONCE_INIT;
+
+// 64-bit FNV-1a, starting from the seed.
+static int hash_symbol(char *s, unsigned long seed)
 {
-    add_builtin(e, "list", b_list);
-    add_builtin(e, "get", b_get);
-    add_builtin(e, "remove", b_remove);
-    add_builtin(e, "eval", b_eval);
-    add_builtin(e, "+", b_add);
-    add_builtin(e, "-", b_sub);
-    add_builtin(e, "*", b_mul);
-    add_builtin(e, "/", b_div);
-    add_builtin(e, "%", b_mod);
-    add_builtin(e, "^", b_pow);
-    add_builtin(e, "def", b_def);
-    add_builtin(e, "=", b_put);
-    add_builtin(e, "env", b_env);
-    add_builtin(e, "exit", b_exit);
-    add_builtin(e, "fun", b_fun);
-    add_builtin(e, "len", b_len);
-    add_builtin(e, ">", b_gt);
-    add_builtin(e, "<", b_lt);
-    add_builtin(e, "||", b_or);
-    add_builtin(e, "&&", b_and);
-    add_builtin(e, "==", b_eq);
-    add_builtin(e, "!", b_not);
-    add_builtin(e, "if", b_if);
-    add_builtin(e, "load", b_load);
-    add_builtin(e, "print", b_print);
-    add_builtin(e, "error", b_error);
-    add_builtin(e, "typeof", b_typeof);
-    add_builtin(e, "string", b_string);
-    add_builtin(e, "int", b_int);
-    add_builtin(e, "float", b_float);
-}
+    unsigned long h = 14695981039346656037UL ^ seed;
 
-// Return the name of a builtin function.
-char *builtin_name(builtin f)
-{
-    if (f == b_list)
-    {
-        return "builtin_list";
-    }
-    if (f == b_get)
-    {
-        return "builtin_get";
-    }
-    if (f == b_remove)
-    {
-        return "builtin_remove";
-    }
-    if (f == b_eval)
-    {
-        return "builtin_eval";
-    }
-    if (f == b_add)
-    {
-        return "builtin_add";
-    }
-    if (f == b_sub)
-    {
-        return "builtin_sub";
-    }
-    if (f == b_mul)
-    {
-        return "builtin_mul";
-    }
-    if (f == b_div)
-    {
-        return "builtin_div";
-    }
-    if (f == b_mod)
-    {
-        return "builtin_mod";
-    }
-    if (f == b_pow)
-    {
-        return "builtin_pow";
-    }
-    if (f == b_def)
-    {
-        return "builtin_def";
-    }
-    if (f == b_put)
-    {
-        return "builtin_put";
-    }
-    if (f == b_env)
-    {
-        return "builtin_env";
-    }
-    if (f == b_exit)
-    {
-        return "builtin_exit";
-    }
-    if (f == b_fun)
-    {
-        return "builtin_fun";
-    }
-    if (f == b_len)
-    {
-        return "builtin_len";
-    }
-    if (f == b_gt)
-    {
-        return "builtin_gt";
-    }
-    if (f == b_lt)
-    {
-        return "builtin_lt";
-    }
-    if (f == b_or)
-    {
-        return "builtin_or";
-    }
-    if (f == b_and)
-    {
-        return "builtin_and";
-    }
-    if (f == b_eq)
+    for (; *s; s++)
     {
-        return "builtin_eq";
+        h = (h ^ (unsigned char)*s) * 1099511628211UL;
     }
-    if (f == b_not)
-    {
-        return "builtin_not";
-    }
-    if (f == b_if)
-    {
-        return "builtin_if";
-    }
-    if (f == b_load)
-    {
-        return "builtin_load";
-    }
-    if (f == b_print)
-    {
-        return "builtin_print";
-    }
-    if (f == b_error)
+
+    return (h ^ (h >> 32)) & (REGISTRY_SLOTS - 1);
+}
+
+// Fibonacci hashing of the address.
+static int hash_fun(builtin f, unsigned long seed)
+{
+    unsigned long h = ((unsigned long)(uintptr_t)f ^ seed) * 11400714819323198485UL;
+
+    return (h >> 32) & (REGISTRY_SLOTS - 1);
+}
+
+// Place each entry by hash of Symbol. Returns 0 if two share a slot.
+static int place_symbols(unsigned long seed)
+{
+    memset(by_symbol, 0, sizeof(by_symbol));
+
+    for (int i = 0; i < REGISTRY_COUNT; i++)
     {
-        return "builtin_error";
+        int h = hash_symbol(registry[i].symbol, seed);
+
+        if (by_symbol[h])
+        {
+            return 0;
+        }
+
+        by_symbol[h] = i + 1;
     }
-    if (f == b_typeof)
+
+    return 1;
+}
+
+// Place each entry by hash of function. A function registered twice keeps its first entry.
+static int place_funs(unsigned long seed)
+{
+    memset(by_fun, 0, sizeof(by_fun));
+
+    for (int i = 0; i < REGISTRY_COUNT; i++)
     {
-        return "builtin_typeof";
+        int h = hash_fun(registry[i].blt, seed);
+
+        if (by_fun[h] && registry[by_fun[h] - 1].blt != registry[i].blt)
+        {
+            return 0;
+        }
+
+        by_fun[h] = by_fun[h] ? by_fun[h] : i + 1;
     }
-    if (f == b_string)
+
+    return 1;
+}
+
+// Try seeds until every entry has its own slot. Functions are hashed by address, so this runs once per process.
+static void registry_init(void)
+{
+    while (!place_symbols(symbol_seed))
     {
-        return "builtin_string";
+        symbol_seed++;
     }
-    if (f == b_int)
+
+    while (!place_funs(fun_seed))
     {
-        return "builtin_int";
+        fun_seed++;
     }
-    if (f == b_float)
+}
+
+// Return the builtin defined as a Symbol, or NULL.
+builtin_info *builtin_symbol(char *symbol)
+{
+    pthread_once(&registry_once, registry_init);
+
+    int i = by_symbol[hash_symbol(symbol, symbol_seed)];
+
+    return i && strcmp(registry[i - 1].symbol, symbol) == 0 ? &registry[i - 1] : NULL;
+}
+
+// Return the registry entry of a builtin function, or NULL (e.g. for natively compiled functions).
+builtin_info *builtin_entry(builtin blt)
+{
+    pthread_once(&registry_once, registry_init);
+
+    int i = by_fun[hash_fun(blt, fun_seed)];
+
+    return i && registry[i - 1].blt == blt ? &registry[i - 1] : NULL;
+}
+
+// Register all builtin functions in the environment.
+void add_builtins(env *e)
+{
+    for (int i = 0; i < REGISTRY_COUNT; i++)
     {
-        return "builtin_float";
+        add_builtin(e, registry[i].symbol, registry[i].blt);
     }
+}
 
-    return "builtin_function";
-}
\ No newline at end of file
+// Return the name of a builtin function.
+char *builtin_name(builtin f)
+{
+    builtin_info *b = builtin_entry(f);
+
+    return b ? b->name : "builtin_function";
+}
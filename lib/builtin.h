@@ -3,19 +3,81 @@
 
 #include "types.h"
 
+// Assert condition is true, otherwise return error and free argument.
+#define ASSERT(args, cond, format, ...)            \
+    if (!(cond))                                   \
+    {                                              \
+        val *err = new_err(format, ##__VA_ARGS__); \
+        free_val(args);                            \
+        return err;                                \
+    }
+
+// Assert type of argument is correct.
+#define ASSERT_TYPE(func, args, index, expect) \
+  ASSERT(args, args->d.exp.list[index]->type == expect, \
+    "Function '%s' passed incorrect type for argument %i. Got %s, Expected %s.", \
+    func, index, type_name(args->d.exp.list[index]->type), type_name(expect))
+
+// Assert number of arguments is correct.
+#define ASSERT_NUM(func, args, num) \
+  ASSERT(args, args->d.exp.count == num, \
+    "Function '%s' passed incorrect number of arguments. Got %i, Expected %i.", \
+    func, args->d.exp.count, num)
+
+// Assert minimum number of arguments.
+#define ASSERT_MIN(func, args, num) \
+  ASSERT(args, args->d.exp.count >= num, \
+    "Function '%s' passed incorrect number of arguments. Got %i, Expected at least %i.", \
+    func, args->d.exp.count, num)
+
+// Assert argument is not empty.
+#define ASSERT_NOT_EMPTY(func, args, index) \
+  ASSERT(args, args->d.exp.list[index]->d.exp.count != 0, \
+    "Function '%s' passed {} for argument %i.", func, index);
+
+// Assert argument is empty.
+#define ASSERT_EMPTY(func, args, index) \
+  ASSERT(args, args->d.exp.list[index]->d.exp.count == 0, \
+    "Function '%s' passed non-empty for argument %i. Expected {}.", func, index);
+
+// Assert type of argument element is correct.
+#define ASSERT_ELEM_TYPE(func, args, index, elem, expect) \
+  ASSERT(args, args->d.exp.list[index]->d.exp.list[elem]->type == expect, \
+    "Function '%s' passed incorrect type for element %i of argument %i. Got %s, Expected %s.", \
+    func, elem, index, type_name(args->d.exp.list[index]->d.exp.list[elem]->type), type_name(expect))
+
+// Assert type of argument is Number.
+#define ASSERT_NUM_TYPE(func, args, index) \
+  ASSERT(args, v->d.exp.list[index]->type == T_INT || v->d.exp.list[index]->type == T_FLT, \
+    "Function '%s' passed incorrect type for argument %i. Got %s, Expected Number.", func, index, type_name(v->d.exp.list[index]->type));
+
+// Assert type of argument is a Float or Integer Array.
+#define ASSERT_ARRAY_TYPE(func, args, index) \
+  ASSERT(args, args->d.exp.list[index]->type == T_F64ARR || args->d.exp.list[index]->type == T_I64ARR, \
+    "Function '%s' passed incorrect type for argument %i. Got %s, Expected Array.", func, index, type_name(args->d.exp.list[index]->type));
+
+// Assert type of argument is Number or String.
+#define ASSERT_NUM_STR_TYPE(func, args, index) \
+  ASSERT(args, v->d.exp.list[index]->type == T_INT || v->d.exp.list[index]->type == T_FLT || v->d.exp.list[index]->type == T_STR, \
+    "Function '%s' passed incorrect type for argument %i. Got %s, Expected Number or String.", func, index, type_name(v->d.exp.list[index]->type));
+
 val *b_head(env *e, val *v);
 
 val *b_tail(env *e, val *v);
 
 val *b_list(env *e, val *v);
 
+val *b_get(env *e, val *v);
+
+val *b_remove(env *e, val *v);
+
 val *b_eval(env *e, val *v);
 
 val *exp_join(val *x, val *y);
 
 val *b_len(env *e, val *v);
 
-int check_reserved(char* sym);
+int check_reserved(char *sym);
 
 val *def_var(env *e, val *v, char *op);
 
@@ -27,12 +89,18 @@ val *b_env(env *e, val *v);
 
 val *b_exit(env *e, val *v);
 
+val *b_mem_stats(env *e, val *v);
+
 val *b_fun(env *e, val *v);
 
 val *b_if(env *e, val *v);
 
+val *run_file(env *e, char *path);
+
 val *b_load(env *e, val *v);
 
+val *b_require(env *e, val *v);
+
 val *b_print(env *e, val *v);
 
 val *b_error(env *e, val *v);
@@ -81,6 +149,27 @@ val *b_float(env *e, val *v);
 
 void add_builtin(env *e, char *key, builtin blt);
 
+// ---------- Registry ----------
+
+// Flags of builtins: folded by the optimizer when all arguments are literals, or otherwise without side effects.
+#define BLT_FOLD 1
+#define BLT_PURE 2
+
+// Entry of the registry of builtins, which defines them in new interpreters.
+typedef struct
+{
+    char *symbol;
+    builtin blt;
+    char *name;
+    int min_args;
+    int max_args;
+    int flags;
+} builtin_info;
+
+builtin_info *builtin_symbol(char *symbol);
+
+builtin_info *builtin_entry(builtin blt);
+
 void add_builtins(env *e);
 
 char *builtin_name(builtin f);
@@ -0,0 +1,316 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "builtin.h"
+#include "types.h"
+#include "parser.h"
+#include "bytes.h"
+
+// Start of the bytes viewed by a Bytes value.
+#define DATA(v) ((v)->d.bytes.blob->data + (v)->d.bytes.off)
+
+// ---------- Create, Free ----------
+
+// Create a zeroed backing store of len bytes.
+blob *blob_new(long len)
+{
+    blob *b = malloc(sizeof(blob));
+    b->refs = 1;
+    b->len = len;
+    b->data = calloc(len > 0 ? len : 1, 1);
+    return b;
+}
+
+// Release a reference. The store is freed with its last reference.
+void blob_free(blob *b)
+{
+    if (__atomic_sub_fetch(&b->refs, 1, __ATOMIC_ACQ_REL) > 0)
+    {
+        return;
+    }
+
+    free(b->data);
+    free(b);
+}
+
+// Add a reference. Copying or slicing a Bytes value is O(1).
+blob *blob_share(blob *b)
+{
+    __atomic_add_fetch(&b->refs, 1, __ATOMIC_RELAXED);
+    return b;
+}
+
+// ---------- Comparison, Hash ----------
+
+// Bytes are equal if they view the same content, regardless of their backing stores.
+int bytes_eq(val *x, val *y)
+{
+    return x->d.bytes.len == y->d.bytes.len && memcmp(DATA(x), DATA(y), x->d.bytes.len) == 0;
+}
+
+unsigned long bytes_hash(val *v)
+{
+    unsigned long h = v->d.bytes.len;
+    unsigned char *p = DATA(v);
+
+    for (long i = 0; i < v->d.bytes.len; i++)
+    {
+        h = (h ^ p[i]) * 1099511628211UL;
+    }
+
+    return h;
+}
+
+// ---------- Print ----------
+
+static const char hex_digits[] = "0123456789abcdef";
+
+// Return the content in hexadecimal. Result must be freed.
+static char *hex_str(val *v)
+{
+    long len = v->d.bytes.len;
+    unsigned char *p = DATA(v);
+    char *str = malloc(len * 2 + 1);
+
+    for (long i = 0; i < len; i++)
+    {
+        str[2 * i] = hex_digits[p[i] >> 4];
+        str[2 * i + 1] = hex_digits[p[i] & 0xF];
+    }
+
+    str[len * 2] = '\0';
+
+    return str;
+}
+
+// Print as an Expression which creates the same Bytes: (hex-bytes "0a1b").
+char *bytes_to_str(val *v)
+{
+    char *hex = hex_str(v);
+    char *str = malloc(strlen(hex) + strlen("(hex-bytes \"\")") + 1);
+
+    sprintf(str, "(hex-bytes \"%s\")", hex);
+    free(hex);
+
+    return str;
+}
+
+// ---------- Builtins ----------
+
+// Create Bytes. Accepts an Integer (number of zero bytes), a String (its characters), or a List of Integers from 0 to 255.
+val *b_bytes(env *e, val *v)
+{
+    ASSERT_NUM("bytes", v, 1);
+
+    val *x = v->d.exp.list[0];
+    blob *b;
+
+    if (x->type == T_INT)
+    {
+        ASSERT(v, x->d.intg >= 0, "Function 'bytes' passed negative length %li.", x->d.intg);
+
+        b = blob_new(x->d.intg);
+    }
+    else if (x->type == T_STR)
+    {
+        b = blob_new(strlen(x->d.str));
+        memcpy(b->data, x->d.str, b->len);
+    }
+    else if (x->type == T_LST)
+    {
+        for (int i = 0; i < x->d.exp.count; i++)
+        {
+            ASSERT_ELEM_TYPE("bytes", v, 0, i, T_INT);
+            ASSERT(v, x->d.exp.list[i]->d.intg >= 0 && x->d.exp.list[i]->d.intg <= 255,
+                "Function 'bytes' passed %li for element %i. Expected 0 to 255.", x->d.exp.list[i]->d.intg, i);
+        }
+
+        b = blob_new(x->d.exp.count);
+
+        for (int i = 0; i < x->d.exp.count; i++)
+        {
+            b->data[i] = x->d.exp.list[i]->d.intg;
+        }
+    }
+    else
+    {
+        val *err = new_err("Function 'bytes' passed incorrect type for argument 0. Got %s, Expected Integer, String or List.",
+            type_name(x->type));
+        free_val(v);
+        return err;
+    }
+
+    free_val(v);
+
+    return new_bytes(b, 0, b->len);
+}
+
+// Return a view of Bytes from start to end (excluded, default: the end), without copying.
+val *b_slice(env *e, val *v)
+{
+    ASSERT(v, v->d.exp.count == 2 || v->d.exp.count == 3,
+        "Function 'slice' passed incorrect number of arguments. Got %i, Expected 2 or 3.", v->d.exp.count);
+    ASSERT_TYPE("slice", v, 0, T_BYTES);
+    ASSERT_TYPE("slice", v, 1, T_INT);
+
+    val *x = v->d.exp.list[0];
+    long start = v->d.exp.list[1]->d.intg;
+    long end = x->d.bytes.len;
+
+    if (v->d.exp.count == 3)
+    {
+        ASSERT_TYPE("slice", v, 2, T_INT);
+        end = v->d.exp.list[2]->d.intg;
+    }
+
+    ASSERT(v, 0 <= start && start <= end && end <= x->d.bytes.len,
+        "Function 'slice' range out of bounds (start: %li, end: %li, length: %li).", start, end, x->d.bytes.len);
+
+    val *s = new_bytes(blob_share(x->d.bytes.blob), x->d.bytes.off + start, end - start);
+
+    free_val(v);
+
+    return s;
+}
+
+// Return the byte at index i as an Integer.
+val *b_bytes_get(env *e, val *v)
+{
+    ASSERT_NUM("bytes-get", v, 2);
+    ASSERT_TYPE("bytes-get", v, 0, T_BYTES);
+    ASSERT_TYPE("bytes-get", v, 1, T_INT);
+
+    val *x = v->d.exp.list[0];
+    long i = v->d.exp.list[1]->d.intg;
+
+    ASSERT(v, i >= 0 && i < x->d.bytes.len,
+        "Function 'bytes-get' index out of bounds (index: %li, length: %li).", i, x->d.bytes.len);
+
+    val *r = new_int(DATA(x)[i]);
+
+    free_val(v);
+
+    return r;
+}
+
+// Return Bytes with the byte at index i set. Accepts Bytes, an index, and an Integer from 0 to 255.
+val *b_bytes_set(env *e, val *v)
+{
+    ASSERT_NUM("bytes-set", v, 3);
+    ASSERT_TYPE("bytes-set", v, 0, T_BYTES);
+    ASSERT_TYPE("bytes-set", v, 1, T_INT);
+    ASSERT_TYPE("bytes-set", v, 2, T_INT);
+
+    long i = v->d.exp.list[1]->d.intg;
+    long x = v->d.exp.list[2]->d.intg;
+    long len = v->d.exp.list[0]->d.bytes.len;
+
+    ASSERT(v, i >= 0 && i < len, "Function 'bytes-set' index out of bounds (index: %li, length: %li).", i, len);
+    ASSERT(v, x >= 0 && x <= 255, "Function 'bytes-set' passed %li for argument 2. Expected 0 to 255.", x);
+
+    val *b = exp_pop(v, 0);
+
+    // Other values see the backing store, so change a copy of the viewed bytes.
+    if (__atomic_load_n(&b->d.bytes.blob->refs, __ATOMIC_ACQUIRE) > 1)
+    {
+        blob *c = blob_new(len);
+        memcpy(c->data, DATA(b), len);
+
+        blob_free(b->d.bytes.blob);
+        b->d.bytes.blob = c;
+        b->d.bytes.off = 0;
+    }
+
+    DATA(b)[i] = x;
+
+    free_val(v);
+
+    return b;
+}
+
+// Read a file into Bytes.
+val *b_read_bytes(env *e, val *v)
+{
+    ASSERT_NUM("read-bytes", v, 1);
+    ASSERT_TYPE("read-bytes", v, 0, T_STR);
+
+    long len;
+    char *data = read_file(v->d.exp.list[0]->d.str, &len);
+
+    ASSERT(v, data, "Function 'read-bytes' unable to read file '%s'.", v->d.exp.list[0]->d.str);
+
+    blob *b = malloc(sizeof(blob));
+    b->refs = 1;
+    b->len = len;
+    b->data = (unsigned char *)data;
+
+    free_val(v);
+
+    return new_bytes(b, 0, len);
+}
+
+// Convert Bytes to a hexadecimal String.
+val *b_bytes_hex(env *e, val *v)
+{
+    ASSERT_NUM("bytes-hex", v, 1);
+    ASSERT_TYPE("bytes-hex", v, 0, T_BYTES);
+
+    char *hex = hex_str(v->d.exp.list[0]);
+    val *s = new_str(hex);
+    free(hex);
+
+    free_val(v);
+
+    return s;
+}
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// Convert a hexadecimal String to Bytes.
+val *b_hex_bytes(env *e, val *v)
+{
+    ASSERT_NUM("hex-bytes", v, 1);
+    ASSERT_TYPE("hex-bytes", v, 0, T_STR);
+
+    char *s = v->d.exp.list[0]->d.str;
+    long len = strlen(s);
+
+    ASSERT(v, len % 2 == 0, "Function 'hex-bytes' passed a String of odd length %li.", len);
+
+    blob *b = blob_new(len / 2);
+
+    for (long i = 0; i < len / 2; i++)
+    {
+        int hi = hex_value(s[2 * i]);
+        int lo = hex_value(s[2 * i + 1]);
+
+        if (hi < 0 || lo < 0)
+        {
+            val *err = new_err("Function 'hex-bytes' passed invalid hexadecimal digit at %li.", hi < 0 ? 2 * i : 2 * i + 1);
+            blob_free(b);
+            free_val(v);
+            return err;
+        }
+
+        b->data[i] = hi << 4 | lo;
+    }
+
+    free_val(v);
+
+    return new_bytes(b, 0, b->len);
+}
@@ -0,0 +1,49 @@
+#ifndef BYTES_H
+#define BYTES_H
+
+#include "types.h"
+
+// Backing store of Bytes values. Shared by slices and copies, and copied before being changed if shared (copy-on-write).
+struct blob
+{
+    int refs;
+
+    long len;
+    unsigned char *data;
+};
+
+// ---------- Create, Free ----------
+
+blob *blob_new(long len);
+
+void blob_free(blob *b);
+
+blob *blob_share(blob *b);
+
+// ---------- Comparison, Hash ----------
+
+int bytes_eq(val *x, val *y);
+
+unsigned long bytes_hash(val *v);
+
+// ---------- Print ----------
+
+char *bytes_to_str(val *v);
+
+// ---------- Builtins ----------
+
+val *b_bytes(env *e, val *v);
+
+val *b_slice(env *e, val *v);
+
+val *b_bytes_get(env *e, val *v);
+
+val *b_bytes_set(env *e, val *v);
+
+val *b_read_bytes(env *e, val *v);
+
+val *b_bytes_hex(env *e, val *v);
+
+val *b_hex_bytes(env *e, val *v);
+
+#endif
@@ -0,0 +1,435 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#define mkdir(path, mode) _mkdir(path)
+#else
+#include <unistd.h>
+#endif
+
+#include "types.h"
+#include "parser.h"
+#include "cache.h"
+
+// Cached parse trees are stored as '<dir>/<hash of canonical path>.zlc', in the following format:
+//   header: "ZLC" + format version byte, then source mtime, size, and content hash (8 bytes each).
+//   body:   the root Expression, where each value is a type byte followed by its payload.
+//           Integers and lengths are stored as variable-length (LEB128) numbers, Floats as 8 raw bytes.
+// Entries are only valid on the machine that wrote them.
+#define CACHE_MAGIC "ZLC\x01"
+#define CACHE_MAGIC_LEN 4
+#define CACHE_HEADER_LEN (CACHE_MAGIC_LEN + 3 * 8)
+
+// Directory of cached parse trees. NULL if caching is disabled.
+static char *cache_dir = NULL;
+
+// Growable byte buffer, used for serialization.
+typedef struct
+{
+    unsigned char *data;
+    long len;
+    long cap;
+} buffer;
+
+// Read cursor, used for deserialization.
+typedef struct
+{
+    unsigned char *data;
+    long len;
+    long pos;
+} cursor;
+
+// ---------- Configuration ----------
+
+// Set the cache directory, and create it if missing. NULL disables caching.
+void cache_set_dir(char *dir)
+{
+    free(cache_dir);
+    cache_dir = NULL;
+
+    if (dir == NULL || dir[0] == '\0')
+    {
+        return;
+    }
+
+    mkdir(dir, 0755);
+
+    cache_dir = malloc(strlen(dir) + 1);
+    strcpy(cache_dir, dir);
+}
+
+char *cache_get_dir(void)
+{
+    return cache_dir;
+}
+
+// ---------- Hashing ----------
+
+// 64-bit FNV-1a.
+static unsigned long long hash_bytes(const void *data, long len)
+{
+    const unsigned char *p = data;
+    unsigned long long h = 14695981039346656037ULL;
+
+    for (long i = 0; i < len; i++)
+    {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+
+    return h;
+}
+
+// Return the cache file path of a source file, or NULL if it can't be resolved. Result must be freed.
+static char *cache_path(char *path)
+{
+    char *canonical = canonical_path(path);
+
+    if (canonical == NULL)
+    {
+        return NULL;
+    }
+
+    char *file = malloc(strlen(cache_dir) + 1 + 16 + 4 + 1);
+    sprintf(file, "%s/%016llx.zlc", cache_dir, hash_bytes(canonical, strlen(canonical)));
+
+    free(canonical);
+
+    return file;
+}
+
+// ---------- Serialization ----------
+
+static void buf_put(buffer *b, const void *data, long len)
+{
+    if (b->len + len > b->cap)
+    {
+        while (b->len + len > b->cap)
+        {
+            b->cap = b->cap ? b->cap * 2 : 256;
+        }
+        b->data = realloc(b->data, b->cap);
+    }
+
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+}
+
+static void buf_put_u64(buffer *b, unsigned long long n)
+{
+    unsigned char bytes[8];
+
+    for (int i = 0; i < 8; i++)
+    {
+        bytes[i] = (n >> (8 * i)) & 0xFF;
+    }
+
+    buf_put(b, bytes, 8);
+}
+
+static void buf_put_varint(buffer *b, unsigned long long n)
+{
+    unsigned char byte;
+
+    do
+    {
+        byte = n & 0x7F;
+        n >>= 7;
+
+        if (n)
+        {
+            byte |= 0x80;
+        }
+
+        buf_put(b, &byte, 1);
+    } while (n);
+}
+
+static void buf_put_val(buffer *b, val *v)
+{
+    unsigned char type = v->type;
+    buf_put(b, &type, 1);
+
+    switch (v->type)
+    {
+    case T_INT:
+        // Zigzag encoding, so small negative numbers stay small.
+        buf_put_varint(b, ((unsigned long long)v->d.intg << 1) ^ (unsigned long long)(v->d.intg >> (sizeof(long) * 8 - 1)));
+        break;
+    case T_FLT:
+        buf_put(b, &v->d.flt, sizeof(double));
+        break;
+
+    case T_ERR:
+    case T_SYM:
+    case T_STR:
+        buf_put_varint(b, strlen(v->d.str));
+        buf_put(b, v->d.str, strlen(v->d.str));
+        break;
+
+    case T_EXP:
+    case T_LST:
+        buf_put_varint(b, v->d.exp.count);
+        for (int i = 0; i < v->d.exp.count; i++)
+        {
+            buf_put_val(b, v->d.exp.list[i]);
+        }
+        break;
+
+    case T_FUN:
+    case T_MOD:
+    case T_MAP:
+    case T_F64ARR:
+    case T_I64ARR:
+    case T_SEQ:
+    case T_BYTES:
+    case T_FILE:
+        // Never produced by the parser.
+        break;
+    }
+}
+
+// ---------- Deserialization ----------
+
+static int cur_get_u64(cursor *c, unsigned long long *n)
+{
+    if (c->pos + 8 > c->len)
+    {
+        return 0;
+    }
+
+    *n = 0;
+    for (int i = 0; i < 8; i++)
+    {
+        *n |= (unsigned long long)c->data[c->pos++] << (8 * i);
+    }
+
+    return 1;
+}
+
+static int cur_get_varint(cursor *c, unsigned long long *n)
+{
+    *n = 0;
+
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (c->pos >= c->len)
+        {
+            return 0;
+        }
+
+        unsigned char byte = c->data[c->pos++];
+        *n |= (unsigned long long)(byte & 0x7F) << shift;
+
+        if (!(byte & 0x80))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// Return the next value, or NULL if the data is malformed.
+static val *cur_get_val(cursor *c)
+{
+    if (c->pos >= c->len)
+    {
+        return NULL;
+    }
+
+    unsigned char type = c->data[c->pos++];
+    unsigned long long n;
+
+    switch (type)
+    {
+    case T_INT:
+        if (!cur_get_varint(c, &n))
+        {
+            return NULL;
+        }
+        return new_int((long)(n >> 1) ^ -(long)(n & 1));
+
+    case T_FLT:
+    {
+        if (c->pos + (long)sizeof(double) > c->len)
+        {
+            return NULL;
+        }
+
+        double f;
+        memcpy(&f, c->data + c->pos, sizeof(double));
+        c->pos += sizeof(double);
+        return new_flt(f);
+    }
+
+    case T_ERR:
+    case T_SYM:
+    case T_STR:
+    {
+        if (!cur_get_varint(c, &n) || n > (unsigned long long)(c->len - c->pos))
+        {
+            return NULL;
+        }
+
+        char *s = malloc(n + 1);
+        memcpy(s, c->data + c->pos, n);
+        s[n] = '\0';
+        c->pos += n;
+
+        val *v = type == T_SYM ? new_sym(s) : new_str(s);
+        v->type = type;
+        free(s);
+        return v;
+    }
+
+    case T_EXP:
+    case T_LST:
+    {
+        if (!cur_get_varint(c, &n))
+        {
+            return NULL;
+        }
+
+        val *v = type == T_EXP ? new_exp() : new_lst();
+
+        for (unsigned long long i = 0; i < n; i++)
+        {
+            val *child = cur_get_val(c);
+
+            if (child == NULL)
+            {
+                free_val(v);
+                return NULL;
+            }
+
+            exp_add(v, child);
+        }
+
+        return v;
+    }
+    }
+
+    return NULL;
+}
+
+// ---------- Read, Write ----------
+
+// Compute the key of a source file, and return its cached parse tree if still valid, otherwise NULL.
+// The key is filled even on a miss, to be passed to cache_write.
+val *cache_read(char *path, char *src, long len, cache_key *key)
+{
+    key->valid = 0;
+
+    if (cache_dir == NULL)
+    {
+        return NULL;
+    }
+
+    struct stat st;
+    if (stat(path, &st) != 0)
+    {
+        return NULL;
+    }
+
+    key->valid = 1;
+    key->mtime = st.st_mtime;
+    key->size = len;
+    key->hash = hash_bytes(src, len);
+
+    char *file = cache_path(path);
+    if (file == NULL)
+    {
+        key->valid = 0;
+        return NULL;
+    }
+
+    FILE *f = fopen(file, "rb");
+    free(file);
+
+    if (f == NULL)
+    {
+        return NULL;
+    }
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    cursor c = {.data = malloc(size > 0 ? size : 1), .len = size, .pos = 0};
+    long read = size > 0 ? fread(c.data, 1, size, f) : 0;
+    fclose(f);
+
+    val *v = NULL;
+    unsigned long long mtime, fsize, hash;
+
+    if (read == size && size >= CACHE_HEADER_LEN && memcmp(c.data, CACHE_MAGIC, CACHE_MAGIC_LEN) == 0)
+    {
+        c.pos = CACHE_MAGIC_LEN;
+        int ok = cur_get_u64(&c, &mtime) && cur_get_u64(&c, &fsize) && cur_get_u64(&c, &hash);
+
+        // Stale if the source changed since the entry was written.
+        if (ok && mtime == key->mtime && fsize == key->size && hash == key->hash)
+        {
+            v = cur_get_val(&c);
+
+            if (v && (v->type != T_EXP || c.pos != c.len))
+            {
+                free_val(v);
+                v = NULL;
+            }
+        }
+    }
+
+    free(c.data);
+
+    return v;
+}
+
+// Store the parse tree of a source file. The entry is written to a temporary file first,
+// so concurrent readers never see a partial entry.
+void cache_write(char *path, cache_key *key, val *v)
+{
+    if (cache_dir == NULL || !key->valid)
+    {
+        return;
+    }
+
+    char *file = cache_path(path);
+    if (file == NULL)
+    {
+        return;
+    }
+
+    buffer b = {.data = NULL, .len = 0, .cap = 0};
+    buf_put(&b, CACHE_MAGIC, CACHE_MAGIC_LEN);
+    buf_put_u64(&b, key->mtime);
+    buf_put_u64(&b, key->size);
+    buf_put_u64(&b, key->hash);
+    buf_put_val(&b, v);
+
+    char *tmp = malloc(strlen(file) + 64);
+    sprintf(tmp, "%s.%ld.%lx.tmp", file, (long)getpid(), (unsigned long)(size_t)key);
+
+    FILE *f = fopen(tmp, "wb");
+    if (f != NULL)
+    {
+        int ok = fwrite(b.data, 1, b.len, f) == (size_t)b.len;
+        ok = (fclose(f) == 0) && ok;
+
+        if (!ok || rename(tmp, file) != 0)
+        {
+            remove(tmp);
+        }
+    }
+
+    free(tmp);
+    free(file);
+    free(b.data);
+}
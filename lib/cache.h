@@ -0,0 +1,28 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "types.h"
+
+// Identifies the exact source a cached parse tree was produced from.
+typedef struct
+{
+    int valid;
+
+    unsigned long long mtime;
+    unsigned long long size;
+    unsigned long long hash;
+} cache_key;
+
+// ---------- Configuration ----------
+
+void cache_set_dir(char *dir);
+
+char *cache_get_dir(void);
+
+// ---------- Read, Write ----------
+
+val *cache_read(char *path, char *src, long len, cache_key *key);
+
+void cache_write(char *path, cache_key *key, val *v);
+
+#endif
@@ -0,0 +1,726 @@
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "mpc.h"
+
+#include "types.h"
+#include "parser.h"
+#include "compile.h"
+
+// Translation of a Z-Lisp file into a C program. Each top-level form becomes C code building the same
+// parse tree, which is evaluated by the interpreter at run time, so every feature (including 'eval') works.
+// Functions on Integers only are also compiled to native C functions, installed in place of the interpreted ones.
+
+// Growable output text.
+typedef struct
+{
+    char *data;
+    long len;
+    long cap;
+} text;
+
+// Function defined at the top level, compiled to native code if its body only uses Integer operations.
+typedef struct
+{
+    char *name;
+    val **params;
+    int param_count;
+    val *body;
+
+    // Index of the form defining it.
+    int form;
+
+    // Still compilable. Cleared if the body uses anything else, or calls a Function which isn't compilable.
+    int native;
+} native_fun;
+
+typedef struct
+{
+    native_fun *funs;
+    int count;
+} program;
+
+// ---------- Text ----------
+
+static void put(text *t, char *format, ...)
+{
+    va_list list;
+
+    va_start(list, format);
+    int n = vsnprintf(NULL, 0, format, list);
+    va_end(list);
+
+    if (t->len + n + 1 > t->cap)
+    {
+        t->cap = (t->len + n + 1) * 2;
+        t->data = realloc(t->data, t->cap);
+    }
+
+    va_start(list, format);
+    vsnprintf(t->data + t->len, n + 1, format, list);
+    va_end(list);
+
+    t->len += n;
+}
+
+// C string literal of s.
+static void put_c_str(text *t, char *s)
+{
+    put(t, "\"");
+
+    for (; *s; s++)
+    {
+        unsigned char c = *s;
+
+        if (c == '"' || c == '\\')
+        {
+            put(t, "\\%c", c);
+        }
+        else if (c == '\n')
+        {
+            put(t, "\\n");
+        }
+        else if (c < 0x20 || c >= 0x7F)
+        {
+            put(t, "\\%03o", c);
+        }
+        else
+        {
+            put(t, "%c", c);
+        }
+    }
+
+    put(t, "\"");
+}
+
+// C identifier for a Symbol. Characters other than letters and digits are written as _XX.
+static void put_ident(text *t, char *prefix, char *name)
+{
+    put(t, "%s", prefix);
+
+    for (; *name; name++)
+    {
+        unsigned char c = *name;
+
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'))
+        {
+            put(t, "%c", c);
+        }
+        else
+        {
+            put(t, "_%02X", c);
+        }
+    }
+}
+
+// ---------- Parse Tree ----------
+
+// C expression which builds a copy of a parse tree.
+static void put_tree(text *t, val *v)
+{
+    switch (v->type)
+    {
+    case T_INT:
+        put(t, "new_int(%ldL)", v->d.intg);
+        break;
+    case T_FLT:
+        put(t, "new_flt(%.17g)", v->d.flt);
+        break;
+    case T_STR:
+        put(t, "new_str(");
+        put_c_str(t, v->d.str);
+        put(t, ")");
+        break;
+    case T_SYM:
+        put(t, "new_sym(");
+        put_c_str(t, v->d.str);
+        put(t, ")");
+        break;
+    case T_ERR:
+        put(t, "new_err(\"%%s\", ");
+        put_c_str(t, v->d.str);
+        put(t, ")");
+        break;
+    case T_EXP:
+    case T_LST:
+        if (v->d.exp.count == 0)
+        {
+            put(t, v->type == T_EXP ? "new_exp()" : "new_lst()");
+            break;
+        }
+
+        put(t, "zl_tree(%s, %d", v->type == T_EXP ? "new_exp()" : "new_lst()", v->d.exp.count);
+        for (int i = 0; i < v->d.exp.count; i++)
+        {
+            put(t, ", ");
+            put_tree(t, v->d.exp.list[i]);
+        }
+        put(t, ")");
+        break;
+    default:
+        // Never produced by the parser.
+        put(t, "new_exp()");
+        break;
+    }
+}
+
+// ---------- Native Functions ----------
+
+static int is_sym(val *v, char *s)
+{
+    return v->type == T_SYM && strcmp(v->d.str, s) == 0;
+}
+
+static int all_syms(val *l)
+{
+    for (int i = 0; i < l->d.exp.count; i++)
+    {
+        if (l->d.exp.list[i]->type != T_SYM || is_sym(l->d.exp.list[i], "&"))
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static native_fun *find_fun(program *p, char *name)
+{
+    for (int i = 0; i < p->count; i++)
+    {
+        if (strcmp(p->funs[i].name, name) == 0)
+        {
+            return &p->funs[i];
+        }
+    }
+
+    return NULL;
+}
+
+// Collect Functions defined with (func {name params} {body}) or (def {name} (fun {params} {body})).
+// Names defined more than once are never compiled, since calls could reach either definition.
+static void find_funs(program *p, val *forms)
+{
+    p->funs = malloc(sizeof(native_fun) * (forms->d.exp.count + 1));
+    p->count = 0;
+
+    for (int i = 0; i < forms->d.exp.count; i++)
+    {
+        val *x = forms->d.exp.list[i];
+        native_fun f = {.form = i, .native = 0};
+
+        if (x->type != T_EXP || x->d.exp.count != 3 || x->d.exp.list[1]->type != T_LST)
+        {
+            continue;
+        }
+
+        val *names = x->d.exp.list[1];
+        val *fn = x->d.exp.list[2];
+
+        if (is_sym(x->d.exp.list[0], "func"))
+        {
+            if (names->d.exp.count == 0 || names->d.exp.list[0]->type != T_SYM)
+            {
+                continue;
+            }
+
+            f.name = names->d.exp.list[0]->d.str;
+
+            if (names->d.exp.count >= 2 && all_syms(names) && fn->type == T_LST)
+            {
+                f.params = names->d.exp.list + 1;
+                f.param_count = names->d.exp.count - 1;
+                f.body = fn;
+                f.native = 1;
+            }
+        }
+        else if (is_sym(x->d.exp.list[0], "def"))
+        {
+            if (names->d.exp.count != 1 || names->d.exp.list[0]->type != T_SYM)
+            {
+                // Several names at once are never compiled, but still redefine earlier Functions.
+                for (int j = 0; j < names->d.exp.count; j++)
+                {
+                    native_fun *prev = names->d.exp.list[j]->type == T_SYM ? find_fun(p, names->d.exp.list[j]->d.str) : NULL;
+
+                    if (prev)
+                    {
+                        prev->native = 0;
+                    }
+                }
+                continue;
+            }
+
+            f.name = names->d.exp.list[0]->d.str;
+
+            if (fn->type == T_EXP && fn->d.exp.count == 3 && is_sym(fn->d.exp.list[0], "fun") &&
+                fn->d.exp.list[1]->type == T_LST && fn->d.exp.list[2]->type == T_LST &&
+                fn->d.exp.list[1]->d.exp.count > 0 && all_syms(fn->d.exp.list[1]))
+            {
+                f.params = fn->d.exp.list[1]->d.exp.list;
+                f.param_count = fn->d.exp.list[1]->d.exp.count;
+                f.body = fn->d.exp.list[2];
+                f.native = 1;
+            }
+        }
+        else
+        {
+            continue;
+        }
+
+        native_fun *prev = find_fun(p, f.name);
+
+        if (prev)
+        {
+            prev->native = 0;
+            continue;
+        }
+
+        p->funs[p->count++] = f;
+    }
+}
+
+static int param_index(native_fun *f, char *name)
+{
+    for (int i = 0; i < f->param_count; i++)
+    {
+        if (strcmp(f->params[i]->d.str, name) == 0)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static int put_native(text *t, program *p, native_fun *f, val *x);
+
+// Body of a Function or branch of 'if': a List evaluated as an Expression. A single element is its value.
+static int put_native_body(text *t, program *p, native_fun *f, val *l)
+{
+    if (l->type != T_LST || l->d.exp.count == 0)
+    {
+        return 0;
+    }
+
+    if (l->d.exp.count == 1)
+    {
+        return put_native(t, p, f, l->d.exp.list[0]);
+    }
+
+    l->type = T_EXP;
+    int ok = put_native(t, p, f, l);
+    l->type = T_LST;
+
+    return ok;
+}
+
+// Operators on two or more Integers, and their C form.
+static char *infix[][2] = {{"+", "+"}, {"-", "-"}, {"*", "*"}};
+
+// Operators on exactly two Integers, and their C form. '!=', '<=' and '>=' are defined in the standard library
+// with the same meaning on Integers.
+static char *binary[][2] = {{"<", "<"}, {">", ">"}, {"==", "=="}, {"!=", "!="}, {"<=", "<="}, {">=", ">="}};
+
+// Operators evaluating all their arguments, implemented by helpers of the generated code.
+static char *helpers[][2] = {{"/", "zl_div"}, {"%", "zl_mod"}, {"&&", "zl_and"}, {"||", "zl_or"}, {"min", "zl_min"}, {"max", "zl_max"}};
+
+#define COUNT(a) (int)(sizeof(a) / sizeof(a[0]))
+
+// Write a value of the body as a C expression on longs. Returns 0 if it uses anything but Integers,
+// the Function's parameters, Integer operators, 'if', and calls of native Functions.
+static int put_native(text *t, program *p, native_fun *f, val *x)
+{
+    if (x->type == T_INT)
+    {
+        put(t, "%ldL", x->d.intg);
+        return 1;
+    }
+
+    if (x->type == T_SYM)
+    {
+        if (param_index(f, x->d.str) < 0)
+        {
+            return 0;
+        }
+
+        put_ident(t, "a_", x->d.str);
+        return 1;
+    }
+
+    if (x->type != T_EXP || x->d.exp.count == 0 || x->d.exp.list[0]->type != T_SYM)
+    {
+        return 0;
+    }
+
+    char *op = x->d.exp.list[0]->d.str;
+    int argc = x->d.exp.count - 1;
+    val **args = x->d.exp.list + 1;
+
+    // Parameters shadow every other Symbol.
+    if (param_index(f, op) >= 0)
+    {
+        return 0;
+    }
+
+    if (strcmp(op, "if") == 0)
+    {
+        if (argc != 3)
+        {
+            return 0;
+        }
+
+        put(t, "(");
+        int ok = put_native(t, p, f, args[0]);
+        put(t, " ? ");
+        ok = ok && put_native_body(t, p, f, args[1]);
+        put(t, " : ");
+        ok = ok && put_native_body(t, p, f, args[2]);
+        put(t, ")");
+
+        return ok;
+    }
+
+    if (strcmp(op, "!") == 0)
+    {
+        if (argc != 1)
+        {
+            return 0;
+        }
+
+        put(t, "(long)!");
+        return put_native(t, p, f, args[0]);
+    }
+
+    for (int i = 0; i < COUNT(infix); i++)
+    {
+        if (strcmp(op, infix[i][0]) == 0)
+        {
+            if (argc < 2)
+            {
+                return 0;
+            }
+
+            int ok = 1;
+
+            // Left to right, like the builtin.
+            for (int j = 0; j < argc - 1; j++)
+            {
+                put(t, "(");
+            }
+            for (int j = 0; j < argc && ok; j++)
+            {
+                if (j)
+                {
+                    put(t, " %s ", infix[i][1]);
+                }
+                ok = put_native(t, p, f, args[j]);
+                if (j)
+                {
+                    put(t, ")");
+                }
+            }
+
+            return ok;
+        }
+    }
+
+    for (int i = 0; i < COUNT(binary); i++)
+    {
+        if (strcmp(op, binary[i][0]) == 0)
+        {
+            if (argc != 2)
+            {
+                return 0;
+            }
+
+            put(t, "(long)(");
+            int ok = put_native(t, p, f, args[0]);
+            put(t, " %s ", binary[i][1]);
+            ok = ok && put_native(t, p, f, args[1]);
+            put(t, ")");
+
+            return ok;
+        }
+    }
+
+    for (int i = 0; i < COUNT(helpers); i++)
+    {
+        if (strcmp(op, helpers[i][0]) == 0)
+        {
+            if (argc < 2)
+            {
+                return 0;
+            }
+
+            int ok = 1;
+
+            for (int j = 0; j < argc - 1; j++)
+            {
+                put(t, "%s(", helpers[i][1]);
+            }
+            for (int j = 0; j < argc && ok; j++)
+            {
+                if (j)
+                {
+                    put(t, ", ");
+                }
+                ok = put_native(t, p, f, args[j]);
+                if (j)
+                {
+                    put(t, ")");
+                }
+            }
+
+            return ok;
+        }
+    }
+
+    // Call of a native Function, with all its arguments.
+    native_fun *g = find_fun(p, op);
+
+    if (g == NULL || !g->native || argc != g->param_count)
+    {
+        return 0;
+    }
+
+    put_ident(t, "zl_", g->name);
+    put(t, "(");
+
+    for (int j = 0; j < argc; j++)
+    {
+        if (j)
+        {
+            put(t, ", ");
+        }
+        if (!put_native(t, p, f, args[j]))
+        {
+            return 0;
+        }
+    }
+
+    put(t, ")");
+    return 1;
+}
+
+// ---------- Program ----------
+
+// Helpers of the generated code. Division by zero jumps back to the calling wrapper, which returns it as an Error.
+// Dividing by -1 wraps like the interpreter, instead of trapping on LONG_MIN.
+static char *prelude =
+    "static __thread jmp_buf zl_fail;\n"
+    "\n"
+    "static inline long zl_div(long x, long y)\n"
+    "{\n"
+    "    if (y == 0)\n"
+    "    {\n"
+    "        longjmp(zl_fail, 1);\n"
+    "    }\n"
+    "    return y == -1 ? (long)(0UL - (unsigned long)x) : x / y;\n"
+    "}\n"
+    "\n"
+    "static inline long zl_mod(long x, long y)\n"
+    "{\n"
+    "    if (y == 0)\n"
+    "    {\n"
+    "        longjmp(zl_fail, 1);\n"
+    "    }\n"
+    "    return y == -1 ? 0 : x % y;\n"
+    "}\n"
+    "\n"
+    "static inline long zl_and(long x, long y)\n"
+    "{\n"
+    "    return x && y;\n"
+    "}\n"
+    "\n"
+    "static inline long zl_or(long x, long y)\n"
+    "{\n"
+    "    return x || y;\n"
+    "}\n"
+    "\n"
+    "static inline long zl_min(long x, long y)\n"
+    "{\n"
+    "    return x < y ? x : y;\n"
+    "}\n"
+    "\n"
+    "static inline long zl_max(long x, long y)\n"
+    "{\n"
+    "    return x > y ? x : y;\n"
+    "}\n"
+    "\n"
+    "// Add elements to a List or Expression.\n"
+    "static val *zl_tree(val *l, int count, ...)\n"
+    "{\n"
+    "    va_list list;\n"
+    "    va_start(list, count);\n"
+    "\n"
+    "    for (int i = 0; i < count; i++)\n"
+    "    {\n"
+    "        exp_add(l, va_arg(list, val *));\n"
+    "    }\n"
+    "\n"
+    "    va_end(list);\n"
+    "    return l;\n"
+    "}\n";
+
+static void put_signature(text *t, native_fun *f)
+{
+    put(t, "static long ");
+    put_ident(t, "zl_", f->name);
+    put(t, "(");
+
+    for (int i = 0; i < f->param_count; i++)
+    {
+        put(t, "%slong ", i ? ", " : "");
+        put_ident(t, "a_", f->params[i]->d.str);
+    }
+
+    put(t, ")");
+}
+
+// Native function, and the builtin wrapping it. Calls with other than Integer arguments go to the interpreted Function.
+static void put_native_fun(text *t, program *p, native_fun *f)
+{
+    put(t, "// %s\n", f->name);
+    put_signature(t, f);
+    put(t, "\n{\n    return ");
+    put_native_body(t, p, f, f->body);
+    put(t, ";\n}\n\n");
+
+    put_ident(t, "static val *zi_", f->name);
+    put(t, " = NULL;\n\n");
+
+    put_ident(t, "static val *zb_", f->name);
+    put(t, "(env *e, val *v)\n{\n");
+    put(t, "    if (v->d.exp.count == %d", f->param_count);
+    for (int i = 0; i < f->param_count; i++)
+    {
+        put(t, " && v->d.exp.list[%d]->type == T_INT", i);
+    }
+    put(t, ")\n    {\n        if (setjmp(zl_fail))\n        {\n            free_val(v);\n            return new_err(\"Division By Zero.\");\n        }\n\n");
+    put(t, "        long r = ");
+    put_ident(t, "zl_", f->name);
+    put(t, "(");
+    for (int i = 0; i < f->param_count; i++)
+    {
+        put(t, "%sv->d.exp.list[%d]->d.intg", i ? ", " : "", i);
+    }
+    put(t, ");\n        free_val(v);\n\n");
+    put(t, "        return new_int(r);\n    }\n\n");
+    put(t, "    val *f = copy_val(");
+    put_ident(t, "zi_", f->name);
+    put(t, ");\n    val *r = call(e, f, v);\n    free_val(f);\n\n    return r;\n}\n\n");
+}
+
+// Translate a Z-Lisp file into a C program, written to out. Returns () or Error if failed.
+val *compile_c(char *path, mpc_parser_t *parser, FILE *out)
+{
+    val *forms = parse_file(path, parser);
+
+    if (forms->type == T_ERR)
+    {
+        return forms;
+    }
+
+    program p;
+    find_funs(&p, forms);
+
+    // Drop Functions until all remaining ones only call each other.
+    text scratch = {.data = NULL, .len = 0, .cap = 0};
+    int changed = 1;
+
+    while (changed)
+    {
+        changed = 0;
+
+        for (int i = 0; i < p.count; i++)
+        {
+            scratch.len = 0;
+
+            if (p.funs[i].native && !put_native_body(&scratch, &p, &p.funs[i], p.funs[i].body))
+            {
+                p.funs[i].native = 0;
+                changed = 1;
+            }
+        }
+    }
+
+    free(scratch.data);
+
+    text t = {.data = NULL, .len = 0, .cap = 0};
+
+    put(&t, "// Generated from '%s' by 'zlisp --compile-c'.\n", path);
+    put(&t, "// Build in the Z-Lisp directory, after 'make lib':\n");
+    put(&t, "//   gcc -std=c99 -O2 -I. -o program program.c libzlisp.a -ledit -lm -lpthread\n");
+    put(&t, "// With -DZLISP_NO_MAIN, only defines zlisp_run, to run the program in an environment of another interpreter.\n\n");
+    put(&t, "#include <stdio.h>\n#include <stdlib.h>\n#include <stdarg.h>\n#include <setjmp.h>\n\n");
+    put(&t, "#include \"lib/types.h\"\n#include \"lib/builtin.h\"\n#include \"lib/parser.h\"\n#include \"lib/interp.h\"\n\n");
+    put(&t, "%s\n", prelude);
+
+    // Prototypes first, since native functions may call each other.
+    put(&t, "// ---------- Native Functions ----------\n\n");
+
+    for (int i = 0; i < p.count; i++)
+    {
+        if (p.funs[i].native)
+        {
+            put_signature(&t, &p.funs[i]);
+            put(&t, ";\n");
+        }
+    }
+    put(&t, "\n");
+
+    for (int i = 0; i < p.count; i++)
+    {
+        if (p.funs[i].native)
+        {
+            put_native_fun(&t, &p, &p.funs[i]);
+        }
+    }
+
+    put(&t, "// ---------- Forms ----------\n\n");
+    put(&t, "// Evaluate the forms in order, like loading the file. Errors are printed.\n");
+    put(&t, "void zlisp_run(env *e)\n{\n    val *x;\n");
+
+    for (int i = 0; i < forms->d.exp.count; i++)
+    {
+        put(&t, "\n    x = eval(e, ");
+        put_tree(&t, forms->d.exp.list[i]);
+        put(&t, ");\n    if (x->type == T_ERR)\n    {\n        fprint_val_ln(env_interp(e)->out, x);\n    }\n    free_val(x);\n");
+
+        // Replace the interpreted Function by its native one, keeping the interpreted one for other arguments.
+        for (int j = 0; j < p.count; j++)
+        {
+            if (p.funs[j].native && p.funs[j].form == i)
+            {
+                put(&t, "    {\n        val *sym = new_sym(");
+                put_c_str(&t, p.funs[j].name);
+                put(&t, ");\n        ");
+                put_ident(&t, "zi_", p.funs[j].name);
+                put(&t, " = env_get(e, sym);\n\n        if (");
+                put_ident(&t, "zi_", p.funs[j].name);
+                put(&t, "->type == T_FUN)\n        {\n            val *f = new_builtin_fun(");
+                put_ident(&t, "zb_", p.funs[j].name);
+                put(&t, ");\n            env_set_global(e, sym, f);\n            free_val(f);\n        }\n\n");
+                put(&t, "        free_val(sym);\n    }\n");
+            }
+        }
+    }
+
+    put(&t, "}\n\n");
+    put(&t, "#ifndef ZLISP_NO_MAIN\n");
+    put(&t, "int main(void)\n{\n");
+    put(&t, "    grammar *g = new_grammar();\n    interp *ip = new_interp(g->parser);\n\n");
+    put(&t, "    val *std = interp_load(ip, \"std.zsp\");\n    if (std->type == T_ERR)\n    {\n        print_val_ln(std);\n    }\n    free_val(std);\n\n");
+    put(&t, "    interp *prev = interp_enter(ip);\n    zlisp_run(ip->env);\n    interp_leave(prev);\n\n");
+    put(&t, "    free_interp(ip);\n    free_grammar(g);\n\n    return 0;\n}\n#endif\n");
+
+    fwrite(t.data, 1, t.len, out);
+
+    free(t.data);
+    free(p.funs);
+    free_val(forms);
+
+    return new_exp();
+}
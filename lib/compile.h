@@ -0,0 +1,14 @@
+#ifndef COMPILE_H
+#define COMPILE_H
+
+#include <stdio.h>
+
+#include "mpc.h"
+
+#include "types.h"
+
+// ---------- Compile ----------
+
+val *compile_c(char *path, mpc_parser_t *parser, FILE *out);
+
+#endif
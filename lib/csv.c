@@ -0,0 +1,389 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "builtin.h"
+#include "types.h"
+#include "parser.h"
+#include "map.h"
+#include "array.h"
+#include "csv.h"
+
+// Fields of a file. Fields point into the file's contents, unquoted and terminated in place.
+typedef struct
+{
+    char **fields;
+    long count;
+    long cap;
+
+    long rows;
+    int cols;
+} table;
+
+// Column types, from most to least specific.
+typedef enum
+{
+    C_INT,
+    C_FLT,
+    C_STR
+} col_t;
+
+#define FIELD(t, row, col) ((t)->fields[(long)(row) * (t)->cols + (col)])
+
+// ---------- Scan ----------
+
+static void add_field(table *t, char *field)
+{
+    if (t->count == t->cap)
+    {
+        t->cap = t->cap ? t->cap * 2 : 1024;
+        t->fields = realloc(t->fields, sizeof(char *) * t->cap);
+    }
+
+    t->fields[t->count++] = field;
+}
+
+// Split the contents (terminated by '\0' at len) into fields, in one pass. Quoted fields follow RFC 4180:
+// they may contain separators and newlines, and "" is a quote. Blank lines are skipped.
+// Returns NULL, or an Error.
+static val *scan(table *t, char *src, long len, char sep)
+{
+    char *p = src;
+    char *end = src + len;
+
+    while (p < end)
+    {
+        if (*p == '\n' || (*p == '\r' && p + 1 < end && p[1] == '\n'))
+        {
+            p += *p == '\r' ? 2 : 1;
+            continue;
+        }
+
+        int cols = 0;
+
+        for (;;)
+        {
+            char *field = p;
+            char *stop;
+
+            if (*p == '"')
+            {
+                // Unquote in place. The result is never longer than the quoted field.
+                char *w = p++;
+
+                for (;;)
+                {
+                    if (p == end)
+                    {
+                        return new_err("Function 'read-csv' found an unterminated quoted field in row %li.", t->rows + 1);
+                    }
+                    if (*p == '"')
+                    {
+                        if (p + 1 < end && p[1] == '"')
+                        {
+                            *w++ = '"';
+                            p += 2;
+                            continue;
+                        }
+                        p++;
+                        break;
+                    }
+                    *w++ = *p++;
+                }
+
+                if (*p == '\r' && p + 1 < end && p[1] == '\n')
+                {
+                    p++;
+                }
+                if (p < end && *p != sep && *p != '\n')
+                {
+                    return new_err("Function 'read-csv' found a character after a quoted field in row %li.", t->rows + 1);
+                }
+
+                stop = w;
+            }
+            else
+            {
+                while (p < end && *p != sep && *p != '\n')
+                {
+                    p++;
+                }
+
+                stop = p > field && p[-1] == '\r' && *p == '\n' ? p - 1 : p;
+            }
+
+            // Read the delimiter before the terminator may overwrite it.
+            char c = p < end ? *p : '\n';
+            *stop = '\0';
+
+            add_field(t, field);
+            cols++;
+
+            p++;
+
+            if (c != sep)
+            {
+                break;
+            }
+            if (p >= end)
+            {
+                // Empty last field, after a separator at the end of the file.
+                add_field(t, end);
+                cols++;
+                break;
+            }
+        }
+
+        if (t->rows == 0)
+        {
+            t->cols = cols;
+        }
+        else if (cols != t->cols)
+        {
+            return new_err("Function 'read-csv' found %i fields in row %li. Expected %i.", cols, t->rows + 1, t->cols);
+        }
+
+        t->rows++;
+    }
+
+    return NULL;
+}
+
+// ---------- Types ----------
+
+static int is_int(char *s, long *n)
+{
+    char *end;
+    errno = 0;
+    *n = strtol(s, &end, 10);
+    return end != s && *end == '\0' && errno == 0;
+}
+
+static int is_flt(char *s, double *n)
+{
+    char *end;
+    errno = 0;
+
+    // Only decimal numbers. Words such as "nan" or "inf" are Strings.
+    if (strchr("+-.0123456789", *s) == NULL || *s == '\0')
+    {
+        return 0;
+    }
+
+    *n = strtod(s, &end);
+    return end != s && *end == '\0' && errno == 0;
+}
+
+// Most specific type of the fields of a column, from row 'first'.
+static col_t column_type(table *t, int col, long first)
+{
+    col_t type = C_INT;
+    long n;
+    double d;
+
+    for (long r = first; r < t->rows; r++)
+    {
+        char *f = FIELD(t, r, col);
+
+        if (type == C_INT && !is_int(f, &n))
+        {
+            type = C_FLT;
+        }
+        if (type == C_FLT && !is_flt(f, &d))
+        {
+            return C_STR;
+        }
+    }
+
+    return type;
+}
+
+static val *field_val(char *f, col_t type)
+{
+    long n;
+    double d;
+
+    switch (type)
+    {
+    case C_INT:
+        is_int(f, &n);
+        return new_int(n);
+    case C_FLT:
+        is_flt(f, &d);
+        return new_flt(d);
+    default:
+        return new_str(f);
+    }
+}
+
+// List of count elements, filled by the caller.
+static val *list_of(long count)
+{
+    val *l = new_lst();
+    exp_reserve(l, count);
+    l->d.exp.count = count;
+    return l;
+}
+
+// ---------- Results ----------
+
+// List of rows, each a List of fields. The header row, if any, is kept as Strings.
+static val *to_rows(table *t, col_t *types, long first)
+{
+    val *rows = list_of(t->rows);
+
+    for (long r = 0; r < t->rows; r++)
+    {
+        val *row = list_of(t->cols);
+
+        for (int c = 0; c < t->cols; c++)
+        {
+            row->d.exp.list[c] = field_val(FIELD(t, r, c), r < first ? C_STR : types[c]);
+        }
+
+        rows->d.exp.list[r] = row;
+    }
+
+    return rows;
+}
+
+// Map of column name (header field, or index) to column: an Integer Array, a Float Array, or a List of Strings.
+static val *to_columns(table *t, col_t *types, long first)
+{
+    val *m = new_map();
+    long count = t->rows - first;
+
+    for (int c = 0; c < t->cols; c++)
+    {
+        val *col;
+
+        if (types[c] == C_INT)
+        {
+            col = new_array(T_I64ARR, count);
+            long *data = col->d.arr->data;
+
+            for (long r = 0; r < count; r++)
+            {
+                is_int(FIELD(t, first + r, c), &data[r]);
+            }
+        }
+        else if (types[c] == C_FLT)
+        {
+            col = new_array(T_F64ARR, count);
+            double *data = col->d.arr->data;
+
+            for (long r = 0; r < count; r++)
+            {
+                is_flt(FIELD(t, first + r, c), &data[r]);
+            }
+        }
+        else
+        {
+            col = list_of(count);
+
+            for (long r = 0; r < count; r++)
+            {
+                col->d.exp.list[r] = new_str(FIELD(t, first + r, c));
+            }
+        }
+
+        val *name = first ? new_str(FIELD(t, 0, c)) : new_int(c);
+
+        if (map_get(m->d.map, name))
+        {
+            val *err = new_err("Function 'read-csv' found duplicate column name '%s'.", FIELD(t, 0, c));
+            free_val(name);
+            free_val(col);
+            free_val(m);
+            return err;
+        }
+
+        map_put(m->d.map, name, col);
+    }
+
+    return m;
+}
+
+// ---------- Builtins ----------
+
+// Read an Integer option from a Map, if present.
+#define INT_OPTION(args, opts, key, out)                                                          \
+    {                                                                                             \
+        val *k = new_str(key);                                                                    \
+        val *o = map_get(opts, k);                                                                \
+        free_val(k);                                                                              \
+        ASSERT(args, o == NULL || o->type == T_INT,                                               \
+            "Function 'read-csv' passed incorrect type for option '%s'. Got %s, Expected Integer.", \
+            key, type_name(o->type));                                                             \
+        if (o)                                                                                    \
+        {                                                                                         \
+            out = o->d.intg;                                                                      \
+        }                                                                                         \
+    }
+
+// Read a delimited file. Accepts a path, and an optional Map of options:
+// "sep" (one-character String, default ","), "header" (first row names the columns, default 1),
+// "columns" (return a Map of columns instead of a List of rows, default 0), and "infer" (convert
+// columns of numbers to Integers or Floats, default 1).
+val *b_read_csv(env *e, val *v)
+{
+    ASSERT(v, v->d.exp.count == 1 || v->d.exp.count == 2,
+        "Function 'read-csv' passed incorrect number of arguments. Got %i, Expected 1 or 2.", v->d.exp.count);
+    ASSERT_TYPE("read-csv", v, 0, T_STR);
+
+    char sep = ',';
+    long header = 1;
+    long columns = 0;
+    long infer = 1;
+
+    if (v->d.exp.count == 2)
+    {
+        ASSERT_TYPE("read-csv", v, 1, T_MAP);
+
+        map *opts = v->d.exp.list[1]->d.map;
+
+        val *k = new_str("sep");
+        val *o = map_get(opts, k);
+        free_val(k);
+
+        if (o)
+        {
+            ASSERT(v, o->type == T_STR && strlen(o->d.str) == 1 && o->d.str[0] != '"' && o->d.str[0] != '\n',
+                "Function 'read-csv' passed incorrect option 'sep'. Expected a String of one character.");
+            sep = o->d.str[0];
+        }
+
+        INT_OPTION(v, opts, "header", header);
+        INT_OPTION(v, opts, "columns", columns);
+        INT_OPTION(v, opts, "infer", infer);
+    }
+
+    long len;
+    char *src = read_file(v->d.exp.list[0]->d.str, &len);
+
+    ASSERT(v, src, "Function 'read-csv' unable to read file '%s'.", v->d.exp.list[0]->d.str);
+
+    table t = {.fields = NULL, .count = 0, .cap = 0, .rows = 0, .cols = 0};
+    val *r = scan(&t, src, len, sep);
+
+    if (r == NULL)
+    {
+        long first = header && t.rows > 0 ? 1 : 0;
+        col_t *types = malloc(sizeof(col_t) * (t.cols ? t.cols : 1));
+
+        for (int c = 0; c < t.cols; c++)
+        {
+            types[c] = infer ? column_type(&t, c, first) : C_STR;
+        }
+
+        r = columns ? to_columns(&t, types, first) : to_rows(&t, types, first);
+
+        free(types);
+    }
+
+    free(t.fields);
+    free(src);
+    free_val(v);
+
+    return r;
+}
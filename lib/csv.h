@@ -0,0 +1,10 @@
+#ifndef CSV_H
+#define CSV_H
+
+#include "types.h"
+
+// ---------- Builtins ----------
+
+val *b_read_csv(env *e, val *v);
+
+#endif
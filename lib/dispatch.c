@@ -0,0 +1,193 @@
+#include <stdlib.h>
+
+#include "types.h"
+#include "builtin.h"
+#include "dispatch.h"
+
+// Jump directly to the code of an operator, with computed gotos (GCC and Clang), or a switch otherwise.
+#ifdef __GNUC__
+#define DISPATCH(op) goto *labels[op];
+#define CASE(op, label) label:
+#else
+#define DISPATCH(op) switch (op)
+#define CASE(op, label) case op:
+#endif
+
+// Builtins, by operator.
+static builtin ops[] = {
+    [OP_ADD] = b_add, [OP_SUB] = b_sub, [OP_MUL] = b_mul, [OP_DIV] = b_div, [OP_MOD] = b_mod, [OP_LT] = b_lt,
+    [OP_GT] = b_gt, [OP_EQ] = b_eq, [OP_NOT] = b_not, [OP_LEN] = b_len, [OP_GET] = b_get
+};
+
+// Return the operator of a builtin, or OP_NONE if it has no fast path.
+int builtin_op(builtin blt)
+{
+    for (int op = OP_NONE + 1; op < (int)(sizeof(ops) / sizeof(ops[0])); op++)
+    {
+        if (ops[op] == blt)
+        {
+            return op;
+        }
+    }
+
+    return OP_NONE;
+}
+
+static int all_ints(val **args, int argc)
+{
+    for (int i = 0; i < argc; i++)
+    {
+        if (args[i]->type != T_INT)
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+// Return the first argument of a call set to n, freeing the rest of the call.
+static val *int_result(val *v, long n)
+{
+    val *x = v->d.exp.list[1];
+    v->d.exp.list[1] = v->d.exp.list[--v->d.exp.count];
+    free_val(v);
+
+    x->d.intg = n;
+    return x;
+}
+
+// Call an operator on the evaluated children of an Expression: the builtin, followed by the arguments, which are
+// used in place. Returns NULL, leaving the Expression unchanged, if the arguments need the builtin itself
+// (other types, errors), so results and errors are always the same as the builtin's.
+val *dispatch(int op, val *v)
+{
+#ifdef __GNUC__
+    static void *labels[] = {
+        [OP_NONE] = &&none, [OP_ADD] = &&add, [OP_SUB] = &&sub, [OP_MUL] = &&mul, [OP_DIV] = &&div, [OP_MOD] = &&mod,
+        [OP_LT] = &&lt, [OP_GT] = &&gt, [OP_EQ] = &&eq, [OP_NOT] = &&not, [OP_LEN] = &&len, [OP_GET] = &&get
+    };
+#endif
+
+    val **args = v->d.exp.list + 1;
+    int argc = v->d.exp.count - 1;
+    long n;
+
+    DISPATCH(op)
+    {
+    CASE(OP_ADD, add)
+        if (argc < 2 || !all_ints(args, argc))
+        {
+            return NULL;
+        }
+        n = args[0]->d.intg;
+        for (int i = 1; i < argc; i++)
+        {
+            n += args[i]->d.intg;
+        }
+        return int_result(v, n);
+
+    CASE(OP_SUB, sub)
+        if (!all_ints(args, argc))
+        {
+            return NULL;
+        }
+        if (argc == 1)
+        {
+            return int_result(v, -args[0]->d.intg);
+        }
+        n = args[0]->d.intg;
+        for (int i = 1; i < argc; i++)
+        {
+            n -= args[i]->d.intg;
+        }
+        return int_result(v, n);
+
+    CASE(OP_MUL, mul)
+        if (argc < 2 || !all_ints(args, argc))
+        {
+            return NULL;
+        }
+        n = args[0]->d.intg;
+        for (int i = 1; i < argc; i++)
+        {
+            n *= args[i]->d.intg;
+        }
+        return int_result(v, n);
+
+    CASE(OP_DIV, div)
+        if (argc != 2 || !all_ints(args, argc) || args[1]->d.intg == 0 || args[1]->d.intg == -1)
+        {
+            return NULL;
+        }
+        return int_result(v, args[0]->d.intg / args[1]->d.intg);
+
+    CASE(OP_MOD, mod)
+        if (argc != 2 || !all_ints(args, argc) || args[1]->d.intg == 0 || args[1]->d.intg == -1)
+        {
+            return NULL;
+        }
+        return int_result(v, args[0]->d.intg % args[1]->d.intg);
+
+    // Like the builtins, the result is that of the last pair of arguments.
+    CASE(OP_LT, lt)
+        if (argc < 2 || !all_ints(args, argc))
+        {
+            return NULL;
+        }
+        return int_result(v, args[argc - 2]->d.intg < args[argc - 1]->d.intg);
+
+    CASE(OP_GT, gt)
+        if (argc < 2 || !all_ints(args, argc))
+        {
+            return NULL;
+        }
+        return int_result(v, args[argc - 2]->d.intg > args[argc - 1]->d.intg);
+
+    CASE(OP_EQ, eq)
+        if (argc != 2)
+        {
+            return NULL;
+        }
+        n = val_eq(args[0], args[1]);
+        free_val(v);
+        return new_int(n);
+
+    CASE(OP_NOT, not)
+        if (argc != 1 || args[0]->type != T_INT)
+        {
+            return NULL;
+        }
+        return int_result(v, !args[0]->d.intg);
+
+    CASE(OP_LEN, len)
+        if (argc != 1 || args[0]->type != T_LST)
+        {
+            return NULL;
+        }
+        n = args[0]->d.exp.count;
+        free_val(v);
+        return new_int(n);
+
+    CASE(OP_GET, get)
+        if (argc != 2 || args[0]->type != T_LST || args[1]->type != T_INT || args[1]->d.intg < 0 ||
+            args[1]->d.intg >= args[0]->d.exp.count)
+        {
+            return NULL;
+        }
+        else
+        {
+            // Take the List out of the call, then the element out of the List.
+            val *l = args[0];
+            long i = args[1]->d.intg;
+            v->d.exp.list[1] = v->d.exp.list[--v->d.exp.count];
+            free_val(v);
+            return exp_take(l, i);
+        }
+
+    CASE(OP_NONE, none)
+        return NULL;
+    }
+
+    return NULL;
+}
@@ -0,0 +1,28 @@
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include "types.h"
+
+// Operators of builtins with a fast path in eval_exp, for their most common arguments: Integers for arithmetic and
+// comparison, and Lists for 'len' and 'get'. Builtins are given their operator when created.
+typedef enum
+{
+    OP_NONE,
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_MOD,
+    OP_LT,
+    OP_GT,
+    OP_EQ,
+    OP_NOT,
+    OP_LEN,
+    OP_GET
+} op_t;
+
+int builtin_op(builtin blt);
+
+val *dispatch(int op, val *v);
+
+#endif
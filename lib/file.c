@@ -0,0 +1,271 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "builtin.h"
+#include "types.h"
+#include "seq.h"
+#include "bytes.h"
+#include "file.h"
+
+// Initial size of the read buffer. Grows for longer lines.
+#define HANDLE_BUF_SIZE (64 * 1024)
+
+// ---------- Create, Free ----------
+
+// Open a file with mode "r", "w" or "a". Returns NULL if it can't be opened.
+handle *handle_open(char *path, char *mode)
+{
+    char m[3] = {mode[0], 'b', '\0'};
+    FILE *f = fopen(path, m);
+
+    if (f == NULL)
+    {
+        return NULL;
+    }
+
+    handle *h = malloc(sizeof(handle));
+    h->refs = 1;
+    h->f = f;
+    h->path = malloc(strlen(path) + 1);
+    strcpy(h->path, path);
+    h->writable = mode[0] != 'r';
+
+    h->buf = NULL;
+    h->cap = 0;
+    h->start = 0;
+    h->end = 0;
+    h->eof = 0;
+
+    // Writes are buffered by stdio, in blocks as large as reads.
+    if (h->writable)
+    {
+        setvbuf(f, NULL, _IOFBF, HANDLE_BUF_SIZE);
+    }
+
+    return h;
+}
+
+static void handle_close(handle *h)
+{
+    if (h->f)
+    {
+        fclose(h->f);
+        h->f = NULL;
+    }
+}
+
+// Release a reference. The file is closed with its last reference.
+void handle_free(handle *h)
+{
+    if (__atomic_sub_fetch(&h->refs, 1, __ATOMIC_ACQ_REL) > 0)
+    {
+        return;
+    }
+
+    handle_close(h);
+    free(h->path);
+    free(h->buf);
+    free(h);
+}
+
+handle *handle_share(handle *h)
+{
+    __atomic_add_fetch(&h->refs, 1, __ATOMIC_RELAXED);
+    return h;
+}
+
+// ---------- Read ----------
+
+// Return the next line without its line ending, or NULL at the end of the file.
+// The line is in the handle's buffer, and is valid until the next read.
+char *handle_read_line(handle *h)
+{
+    if (h->f == NULL || h->writable)
+    {
+        return NULL;
+    }
+
+    // One more byte, to terminate a last line without a newline.
+    if (h->buf == NULL)
+    {
+        h->cap = HANDLE_BUF_SIZE;
+        h->buf = malloc(h->cap + 1);
+    }
+
+    for (;;)
+    {
+        char *line = h->buf + h->start;
+        char *nl = h->end > h->start ? memchr(line, '\n', h->end - h->start) : NULL;
+
+        // Last line, without a newline.
+        if (nl == NULL && h->eof && h->start < h->end)
+        {
+            nl = h->buf + h->end;
+        }
+
+        if (nl)
+        {
+            h->start = nl - h->buf + 1;
+
+            if (nl > line && nl[-1] == '\r')
+            {
+                nl--;
+            }
+            *nl = '\0';
+
+            return line;
+        }
+
+        if (h->eof)
+        {
+            return NULL;
+        }
+
+        // Move the partial line to the front, and grow if it fills the buffer.
+        memmove(h->buf, h->buf + h->start, h->end - h->start);
+        h->end -= h->start;
+        h->start = 0;
+
+        if (h->end == h->cap)
+        {
+            h->cap *= 2;
+            h->buf = realloc(h->buf, h->cap + 1);
+        }
+
+        size_t n = fread(h->buf + h->end, 1, h->cap - h->end, h->f);
+        h->end += n;
+
+        if (n == 0)
+        {
+            h->eof = 1;
+        }
+    }
+}
+
+// ---------- Builtins ----------
+
+// Open a file. Accepts a path, and an optional mode: "r" (read, default), "w" (write) or "a" (append).
+val *b_open(env *e, val *v)
+{
+    ASSERT(v, v->d.exp.count == 1 || v->d.exp.count == 2,
+        "Function 'open' passed incorrect number of arguments. Got %i, Expected 1 or 2.", v->d.exp.count);
+    ASSERT_TYPE("open", v, 0, T_STR);
+
+    char *mode = "r";
+
+    if (v->d.exp.count == 2)
+    {
+        ASSERT_TYPE("open", v, 1, T_STR);
+        mode = v->d.exp.list[1]->d.str;
+
+        ASSERT(v, strcmp(mode, "r") == 0 || strcmp(mode, "w") == 0 || strcmp(mode, "a") == 0,
+            "Function 'open' passed unknown mode '%s'. Expected r, w or a.", mode);
+    }
+
+    handle *h = handle_open(v->d.exp.list[0]->d.str, mode);
+
+    ASSERT(v, h, "Function 'open' unable to open file '%s'.", v->d.exp.list[0]->d.str);
+
+    free_val(v);
+
+    return new_file(h);
+}
+
+// Close a File. Later reads and writes fail.
+val *b_close(env *e, val *v)
+{
+    ASSERT_NUM("close", v, 1);
+    ASSERT_TYPE("close", v, 0, T_FILE);
+
+    handle_close(v->d.exp.list[0]->d.file);
+
+    free_val(v);
+
+    return new_exp();
+}
+
+// Read the next line of a File, without its line ending. Returns {} at the end of the file.
+val *b_read_line(env *e, val *v)
+{
+    ASSERT_NUM("read-line", v, 1);
+    ASSERT_TYPE("read-line", v, 0, T_FILE);
+
+    handle *h = v->d.exp.list[0]->d.file;
+
+    ASSERT(v, h->f, "Function 'read-line' passed a closed File '%s'.", h->path);
+    ASSERT(v, !h->writable, "Function 'read-line' passed a File opened for writing '%s'.", h->path);
+
+    char *line = handle_read_line(h);
+    val *r = line ? new_str(line) : new_lst();
+
+    free_val(v);
+
+    return r;
+}
+
+// Write values to a File. Strings and Bytes are written as they are, other values as printed.
+// Accepts a File, followed by any number of values.
+val *b_write(env *e, val *v)
+{
+    ASSERT_MIN("write", v, 2);
+    ASSERT_TYPE("write", v, 0, T_FILE);
+
+    handle *h = v->d.exp.list[0]->d.file;
+
+    ASSERT(v, h->f, "Function 'write' passed a closed File '%s'.", h->path);
+    ASSERT(v, h->writable, "Function 'write' passed a File opened for reading '%s'.", h->path);
+
+    for (int i = 1; i < v->d.exp.count; i++)
+    {
+        val *x = v->d.exp.list[i];
+
+        if (x->type == T_STR)
+        {
+            fputs(x->d.str, h->f);
+        }
+        else if (x->type == T_BYTES)
+        {
+            fwrite(x->d.bytes.blob->data + x->d.bytes.off, 1, x->d.bytes.len, h->f);
+        }
+        else
+        {
+            fprint_val(h->f, x);
+        }
+    }
+
+    int failed = ferror(h->f);
+
+    ASSERT(v, !failed, "Function 'write' failed to write to '%s'.", h->path);
+
+    free_val(v);
+
+    return new_exp();
+}
+
+// Return the lines of a file as a lazy Sequence. Accepts a path, read from the start each time the Sequence is consumed,
+// or a File, read from its current position.
+val *b_lines(env *e, val *v)
+{
+    ASSERT_NUM("lines", v, 1);
+
+    val *x = v->d.exp.list[0];
+
+    ASSERT(v, x->type == T_STR || x->type == T_FILE,
+        "Function 'lines' passed incorrect type for argument 0. Got %s, Expected String or File.", type_name(x->type));
+
+    seq *s = seq_new(S_LINES, NULL);
+
+    if (x->type == T_STR)
+    {
+        s->path = malloc(strlen(x->d.str) + 1);
+        strcpy(s->path, x->d.str);
+    }
+    else
+    {
+        s->file = handle_share(x->d.file);
+    }
+
+    free_val(v);
+
+    return new_seq(s);
+}
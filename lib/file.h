@@ -0,0 +1,49 @@
+#ifndef FILE_H
+#define FILE_H
+
+#include <stdio.h>
+
+#include "types.h"
+
+// Open file. Shared by copies of a File value, and closed by 'close' or with its last reference.
+// Lines are read from an internal buffer filled in large blocks.
+struct handle
+{
+    int refs;
+
+    FILE *f;
+    char *path;
+    int writable;
+
+    char *buf;
+    long cap;
+    long start;
+    long end;
+    int eof;
+};
+
+// ---------- Create, Free ----------
+
+handle *handle_open(char *path, char *mode);
+
+void handle_free(handle *h);
+
+handle *handle_share(handle *h);
+
+// ---------- Read ----------
+
+char *handle_read_line(handle *h);
+
+// ---------- Builtins ----------
+
+val *b_open(env *e, val *v);
+
+val *b_close(env *e, val *v);
+
+val *b_read_line(env *e, val *v);
+
+val *b_write(env *e, val *v);
+
+val *b_lines(env *e, val *v);
+
+#endif
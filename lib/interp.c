@@ -0,0 +1,543 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "mpc.h"
+
+#include "types.h"
+#include "builtin.h"
+#include "parser.h"
+#include "interp.h"
+
+// Vals of the first chunk of an interpreter. Each next chunk is twice as large, up to CHUNK_MAX.
+#define CHUNK_MIN 1024
+#define CHUNK_MAX 65536
+
+// Most vals freed on a thread without interpreter kept by the thread, before giving them to the shared pool.
+#define SPARE_MAX 4096
+
+// Queued List elements freed per allocation.
+#define SWEEP_STEP 8
+
+int free_budget = 0;
+
+// Freed val, linked in a free list.
+typedef struct free_node
+{
+    struct free_node *next;
+} free_node;
+
+// Vals allocated together. Vals can be freed on any thread, into any free list, so chunks are never freed.
+typedef struct chunk
+{
+    struct chunk *next;
+    val vals[];
+} chunk;
+
+__thread interp *current_interp = NULL;
+
+// Shared pool: all chunks, and the vals given up by freed interpreters and finished threads, taken by the first
+// interpreter running out of vals.
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static chunk *chunks = NULL;
+static free_node *pooled = NULL;
+
+// Vals freed on this thread without interpreter (e.g. workers of 'pmap'), reused by its next allocations.
+static __thread free_node *spare = NULL;
+static __thread int spare_count = 0;
+static __thread int spare_registered = 0;
+
+// Gives the spare vals of a thread to the pool when it exits.
+static pthread_key_t spare_key;
+static pthread_once_t spare_once = PTHREAD_ONCE_INIT;
+
+static void pool_give(free_node *list);
+
+// ---------- Constructors ----------
+
+// Create an interpreter with a global environment containing only the builtins.
+interp *new_interp(mpc_parser_t *parser)
+{
+    interp *ip = malloc(sizeof(interp));
+
+    *ip = (interp){.parser = parser, .env = new_env(), .out = stdout};
+
+    ip->env->ip = ip;
+    add_builtins(ip->env);
+
+    return ip;
+}
+
+// ---------- Destructors ----------
+
+void free_interp(interp *ip)
+{
+    // Values freed while running are kept by the current interpreter, so never release this one into itself.
+    interp *prev = interp_enter(NULL);
+
+    for (int i = 0; i < ip->module_count; i++)
+    {
+        free(ip->module_paths[i]);
+        free_env(ip->module_envs[i]);
+    }
+    free(ip->module_paths);
+    free(ip->module_envs);
+
+    free_env(ip->env);
+
+    while (ip->sweep.count)
+    {
+        exp_sweep(ip, SWEEP_STEP);
+    }
+    free(ip->sweep.items);
+
+    if (ip->out != stdout)
+    {
+        fclose(ip->out);
+        free(ip->out_buf);
+    }
+
+    // Give up the vals kept for reuse, including the unused rest of the current chunk.
+    for (val *v = ip->alloc.next; v < ip->alloc.end; v++)
+    {
+        free_node *n = (free_node *)v;
+        n->next = ip->alloc.free;
+        ip->alloc.free = n;
+    }
+
+    pool_give(ip->alloc.free);
+
+    free(ip);
+
+    interp_leave(prev == ip ? NULL : prev);
+}
+
+// ---------- Copy ----------
+
+// Create an isolated interpreter, starting from a copy of the global environment.
+// Loaded modules are not copied, and output goes to stdout. The copy is made by the new interpreter, so its stats
+// count the copied environment as allocated and live, like anything it makes later.
+interp *copy_interp(interp *ip)
+{
+    interp *c = malloc(sizeof(interp));
+
+    *c = (interp){.parser = ip->parser, .out = stdout};
+
+    interp *prev = interp_enter(c);
+    c->env = copy_env(ip->env);
+    interp_leave(prev);
+
+    c->env->ip = c;
+
+    return c;
+}
+
+// ---------- Run ----------
+
+// Make an interpreter current on the calling thread. Returns the previous one, to be restored by interp_leave.
+interp *interp_enter(interp *ip)
+{
+    interp *prev = current_interp;
+    current_interp = ip;
+    return prev;
+}
+
+void interp_leave(interp *prev)
+{
+    current_interp = prev;
+}
+
+// Load/run a file in the global environment. Returns () or Error if failed.
+val *interp_load(interp *ip, char *path)
+{
+    interp *prev = interp_enter(ip);
+    val *x = run_file(ip->env, path);
+    interp_leave(prev);
+
+    return x;
+}
+
+// Parse and evaluate input in the global environment, and return the result.
+val *interp_eval(interp *ip, char *input)
+{
+    interp *prev = interp_enter(ip);
+    val *x = parse(input, ip->parser, ip->env);
+    interp_leave(prev);
+
+    return x;
+}
+
+static double seconds(clockid_t clock)
+{
+    struct timespec t;
+    clock_gettime(clock, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// Like interp_eval, also measuring the cost of the input.
+val *interp_eval_cost(interp *ip, char *input, cost *c)
+{
+    stats before = ip->stats;
+
+    // Track the peak of this input only, then keep the larger of both.
+    ip->stats.peak = ip->stats.live;
+
+    double wall = seconds(CLOCK_MONOTONIC);
+    double cpu = seconds(CLOCK_PROCESS_CPUTIME_ID);
+
+    val *x = interp_eval(ip, input);
+
+    c->wall = seconds(CLOCK_MONOTONIC) - wall;
+    c->cpu = seconds(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+
+    stats *s = &ip->stats;
+    c->allocs = s->allocs - before.allocs;
+    c->reuses = s->reuses - before.reuses;
+    c->bytes = s->bytes - before.bytes;
+    c->copies = s->copies - before.copies;
+    c->list_copies = s->list_copies - before.list_copies;
+    c->envs = s->envs - before.envs;
+    c->peak = s->peak - before.live;
+
+    s->peak = s->peak > before.peak ? s->peak : before.peak;
+
+    return x;
+}
+
+// ---------- Allocator ----------
+
+// Add a list of vals to the shared pool.
+static void pool_give(free_node *list)
+{
+    if (list == NULL)
+    {
+        return;
+    }
+
+    free_node *last = list;
+    while (last->next)
+    {
+        last = last->next;
+    }
+
+    pthread_mutex_lock(&pool_lock);
+    last->next = pooled;
+    __atomic_store_n(&pooled, list, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&pool_lock);
+}
+
+// Take all vals of the shared pool, or NULL if empty.
+static free_node *pool_take(void)
+{
+    if (__atomic_load_n(&pooled, __ATOMIC_RELAXED) == NULL)
+    {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&pool_lock);
+    free_node *list = pooled;
+    __atomic_store_n(&pooled, NULL, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&pool_lock);
+
+    return list;
+}
+
+static void spare_exit(void *unused)
+{
+    pool_give(spare);
+    spare = NULL;
+    spare_count = 0;
+}
+
+static void spare_init(void)
+{
+    pthread_key_create(&spare_key, spare_exit);
+}
+
+// Start the next chunk of an interpreter.
+static void next_chunk(allocator *a)
+{
+    a->chunk = a->chunk == 0 ? CHUNK_MIN : a->chunk < CHUNK_MAX ? a->chunk * 2 : CHUNK_MAX;
+
+    chunk *c = malloc(sizeof(chunk) + sizeof(val) * a->chunk);
+
+    pthread_mutex_lock(&pool_lock);
+    c->next = chunks;
+    chunks = c;
+    pthread_mutex_unlock(&pool_lock);
+
+    a->next = c->vals;
+    a->end = c->vals + a->chunk;
+}
+
+// Allocate a val of a type: a val freed on the current interpreter if any, otherwise one of the shared pool,
+// otherwise the next of the interpreter's chunk. Allocating never calls malloc, except for a new chunk.
+// Without a current interpreter (e.g. worker threads of 'pmap'), vals freed on the thread are reused, otherwise
+// they come from malloc.
+val *val_alloc(val_t type)
+{
+    interp *ip = current_interp;
+
+    if (ip)
+    {
+        // Pay for freeing queued Lists as new vals are made.
+        if (ip->sweep.count)
+        {
+            exp_sweep(ip, SWEEP_STEP);
+        }
+
+        ip->stats.allocs++;
+        ip->stats.types[type]++;
+        ip->stats.bytes += sizeof(val);
+
+        if (++ip->stats.live > ip->stats.peak)
+        {
+            ip->stats.peak = ip->stats.live;
+        }
+
+        if (ip->alloc.free == NULL)
+        {
+            ip->alloc.free = pool_take();
+        }
+
+        if (ip->alloc.free)
+        {
+            free_node *n = ip->alloc.free;
+            ip->alloc.free = n->next;
+            ip->stats.reuses++;
+
+            return (val *)n;
+        }
+
+        if (ip->alloc.next == ip->alloc.end)
+        {
+            next_chunk(&ip->alloc);
+        }
+
+        return ip->alloc.next++;
+    }
+
+    if (spare)
+    {
+        free_node *n = spare;
+        spare = n->next;
+        spare_count--;
+
+        return (val *)n;
+    }
+
+    return malloc(sizeof(val));
+}
+
+// Keep a freed val for reuse. Vals are never returned to malloc, since they may belong to a chunk.
+void val_release(val *v)
+{
+    interp *ip = current_interp;
+    free_node *n = (free_node *)v;
+
+    if (ip)
+    {
+        ip->stats.live--;
+
+        n->next = ip->alloc.free;
+        ip->alloc.free = n;
+
+        return;
+    }
+
+    if (!spare_registered)
+    {
+        pthread_once(&spare_once, spare_init);
+        pthread_setspecific(spare_key, &spare_registered);
+        spare_registered = 1;
+    }
+
+    n->next = spare;
+    spare = n;
+
+    if (++spare_count > SPARE_MAX)
+    {
+        pool_give(spare);
+        spare = NULL;
+        spare_count = 0;
+    }
+}
+
+// ---------- Statistics ----------
+
+// Count a lookup which searched depth environments.
+void stat_lookup(int depth)
+{
+    interp *ip = current_interp;
+
+    if (ip)
+    {
+        ip->stats.lookups++;
+        ip->stats.lookup_depth += depth;
+
+        if (depth > ip->stats.max_lookup_depth)
+        {
+            ip->stats.max_lookup_depth = depth;
+        }
+    }
+}
+
+// Count a List freed at once, by the time it took.
+void stat_pause(double seconds)
+{
+    interp *ip = current_interp;
+
+    if (ip)
+    {
+        int b = 0;
+        for (double limit = 1e-5; b < PAUSE_BUCKETS - 1 && seconds >= limit; limit *= 10)
+        {
+            b++;
+        }
+
+        ip->stats.pauses[b]++;
+    }
+}
+
+static val *stat_pair(char *name, val *x)
+{
+    return exp_add(exp_add(new_lst(), new_str(name)), x);
+}
+
+// Upper bounds of the pause buckets.
+static char *pause_names[PAUSE_BUCKETS] = {"10us", "100us", "1ms", "10ms", "100ms", "more"};
+
+// Return statistics as a List of {name value} pairs. "types" is a List of {type count} pairs.
+// Taken before the List is created, so it doesn't count itself.
+val *stats_list(stats *s)
+{
+    stats c = *s;
+
+    val *types = new_lst();
+    for (int t = 0; t < TYPE_COUNT; t++)
+    {
+        exp_add(types, stat_pair(type_name(t), new_int(c.types[t])));
+    }
+
+    val *pauses = new_lst();
+    for (int b = 0; b < PAUSE_BUCKETS; b++)
+    {
+        exp_add(pauses, stat_pair(pause_names[b], new_int(c.pauses[b])));
+    }
+
+    val *l = new_lst();
+    exp_add(l, stat_pair("allocs", new_int(c.allocs)));
+    exp_add(l, stat_pair("reuses", new_int(c.reuses)));
+    exp_add(l, stat_pair("live", new_int(c.live)));
+    exp_add(l, stat_pair("peak", new_int(c.peak)));
+    exp_add(l, stat_pair("bytes", new_int(c.bytes)));
+    exp_add(l, stat_pair("copies", new_int(c.copies)));
+    exp_add(l, stat_pair("list-copies", new_int(c.list_copies)));
+    exp_add(l, stat_pair("envs", new_int(c.envs)));
+    exp_add(l, stat_pair("env-copies", new_int(c.env_copies)));
+    exp_add(l, stat_pair("live-envs", new_int(c.live_envs)));
+    exp_add(l, stat_pair("peak-envs", new_int(c.peak_envs)));
+    exp_add(l, stat_pair("lookups", new_int(c.lookups)));
+    exp_add(l, stat_pair("lookup-hits", new_int(c.lookup_hits)));
+    exp_add(l, stat_pair("lookup-depth", new_int(c.lookup_depth)));
+    exp_add(l, stat_pair("max-lookup-depth", new_int(c.max_lookup_depth)));
+    exp_add(l, stat_pair("pauses", pauses));
+    exp_add(l, stat_pair("deferred", new_int(c.deferred)));
+    exp_add(l, stat_pair("types", types));
+
+    return l;
+}
+
+// Print a summary of statistics.
+void fprint_stats(FILE *f, stats *s)
+{
+    fprintf(f, "---------- Statistics ----------\n");
+    fprintf(f, "Vals:         %ld allocated, %ld reused, %ld live, %ld peak\n", s->allocs, s->reuses, s->live, s->peak);
+    fprintf(f, "Bytes:        %ld allocated\n", s->bytes);
+    fprintf(f, "Copies:       %ld vals, %ld Lists copied on write\n", s->copies, s->list_copies);
+    fprintf(f, "Environments: %ld created, %ld copied, %ld live, %ld peak\n", s->envs, s->env_copies, s->live_envs, s->peak_envs);
+    fprintf(f, "Lookups:      %ld, %ld cached, %.2f environments searched on average by others, %ld at most\n",
+        s->lookups, s->lookup_hits, s->lookups > s->lookup_hits ? (double)s->lookup_depth / (s->lookups - s->lookup_hits) : 0.0,
+        s->max_lookup_depth);
+    fprintf(f, "Pauses:       ");
+    for (int b = 0; b < PAUSE_BUCKETS; b++)
+    {
+        fprintf(f, "%s%ld %s %s", b ? ", " : "", s->pauses[b], b < PAUSE_BUCKETS - 1 ? "under" : "over", pause_names[b < PAUSE_BUCKETS - 1 ? b : b - 1]);
+    }
+    fprintf(f, "; %ld Lists freed incrementally\n", s->deferred);
+    fprintf(f, "By type:\n");
+
+    for (int t = 0; t < TYPE_COUNT; t++)
+    {
+        if (s->types[t])
+        {
+            fprintf(f, "  %-14s %ld\n", type_name(t), s->types[t]);
+        }
+    }
+}
+
+// Print the time taken by an input, for ',time' in the interactive prompt.
+void fprint_time(FILE *f, cost *c)
+{
+    fprintf(f, "Time: %.3f ms wall, %.3f ms CPU\n", c->wall * 1e3, c->cpu * 1e3);
+}
+
+// Print the vals allocated and copied by an input, for ',alloc' in the interactive prompt.
+void fprint_alloc(FILE *f, cost *c)
+{
+    fprintf(f, "Allocated: %ld vals (%ld reused), %ld bytes, %ld environments\n", c->allocs, c->reuses, c->bytes, c->envs);
+    fprintf(f, "Copied:    %ld vals, %ld Lists on write\n", c->copies, c->list_copies);
+    fprintf(f, "Peak:      %ld vals live (%ld bytes) above the start\n", c->peak, c->peak * (long)sizeof(val));
+}
+
+// ---------- Output ----------
+
+// Collect output in a buffer instead of writing it to stdout.
+void interp_capture(interp *ip)
+{
+    if (ip->out != stdout)
+    {
+        return;
+    }
+
+#ifdef _WIN32
+    ip->out = tmpfile();
+#else
+    ip->out = open_memstream(&ip->out_buf, &ip->out_len);
+#endif
+}
+
+// Return output collected since interp_capture. Owned by the interpreter.
+char *interp_output(interp *ip, size_t *len)
+{
+    fflush(ip->out);
+
+#ifdef _WIN32
+    *len = ftell(ip->out);
+    ip->out_buf = realloc(ip->out_buf, *len + 1);
+    rewind(ip->out);
+    *len = fread(ip->out_buf, 1, *len, ip->out);
+    ip->out_buf[*len] = '\0';
+#else
+    *len = ip->out_len;
+#endif
+
+    return ip->out_buf;
+}
+
+// ---------- Environment - Interpreter ----------
+
+// Return the interpreter owning the global environment reached from an environment.
+interp *env_interp(env *e)
+{
+    while (e->parent)
+    {
+        e = e->parent;
+    }
+
+    return e->ip;
+}
@@ -0,0 +1,190 @@
+#ifndef INTERP_H
+#define INTERP_H
+
+#include <stdio.h>
+
+#include "mpc.h"
+
+#include "types.h"
+
+// Allocator of vals. Vals are carved from chunks, and freed vals are kept for reuse instead of being returned
+// to malloc (see interp.c).
+typedef struct
+{
+    void *free;
+
+    // Rest of the current chunk, and the number of vals of the next one.
+    val *next;
+    val *end;
+    int chunk;
+} allocator;
+
+// List being freed a few elements at a time: its elements, and how many are left.
+typedef struct
+{
+    val **list;
+    int count;
+} pending;
+
+// Lists queued to be freed with '--free-budget', the last first. See exp_sweep.
+typedef struct
+{
+    pending *items;
+    int count;
+    int cap;
+} sweeper;
+
+// Lists freed at once, by time taken: under 10us, 100us, 1ms, 10ms, 100ms, and longer.
+#define PAUSE_BUCKETS 6
+
+// Least elements of a List whose freeing is timed.
+#define PAUSE_MIN 1024
+
+// Statistics of an interpreter. Counted on the interpreter's own thread only.
+typedef struct
+{
+    // Vals allocated, of which reused from the free list, and by type.
+    long allocs;
+    long reuses;
+    long types[TYPE_COUNT];
+
+    // Vals allocated and not yet freed, now and at most.
+    long live;
+    long peak;
+
+    // Bytes allocated for vals, environments, String contents and List elements.
+    long bytes;
+
+    // Vals copied by copy_val, and Lists whose shared elements were copied to be changed.
+    long copies;
+    long list_copies;
+
+    // Environments created, of which by copy_env, and not yet freed, now and at most.
+    long envs;
+    long env_copies;
+    long live_envs;
+    long peak_envs;
+
+    // Symbol lookups, of which answered by the cache of their Symbol, and the environments searched by the others,
+    // in total and at most.
+    long lookups;
+    long lookup_hits;
+    long lookup_depth;
+    long max_lookup_depth;
+
+    // Lists of at least PAUSE_MIN elements freed at once, by time taken, and Lists queued to be freed later.
+    long pauses[PAUSE_BUCKETS];
+    long deferred;
+} stats;
+
+// Add to a statistic of the current interpreter, if any.
+#define STAT_ADD(field, n)                     \
+    if (current_interp)                        \
+    {                                          \
+        current_interp->stats.field += (n);    \
+    }
+
+// State of one interpreter. Interpreters share nothing mutable, so each can run on its own thread.
+// Embedding: create with new_interp, run code with interp_load/interp_eval, and release with free_interp.
+struct interp
+{
+    // Parser of the grammar, shared read-only.
+    mpc_parser_t *parser;
+
+    // Global environment.
+    env *env;
+
+    // Destination of 'print' and reported errors. Either stdout, or a buffer enabled by interp_capture.
+    FILE *out;
+    char *out_buf;
+    size_t out_len;
+
+    // Modules loaded by 'require', by canonical path.
+    int module_count;
+    char **module_paths;
+    env **module_envs;
+
+    allocator alloc;
+    sweeper sweep;
+
+    stats stats;
+};
+
+// Cost of evaluating one input: wall and CPU time in seconds (CPU time of all threads), and the statistics counted
+// meanwhile. 'peak' is the most vals live at once, above those live before.
+typedef struct
+{
+    double wall;
+    double cpu;
+
+    long allocs;
+    long reuses;
+    long bytes;
+    long copies;
+    long list_copies;
+    long envs;
+    long peak;
+} cost;
+
+// Most elements of a List freed at once, set by '--free-budget'. Larger Lists are queued and freed a few elements
+// per allocation. 0 frees all Lists at once.
+extern int free_budget;
+
+// Interpreter running on the calling thread. Reaches the context from code without an environment.
+extern __thread interp *current_interp;
+
+// ---------- Constructors ----------
+
+interp *new_interp(mpc_parser_t *parser);
+
+// ---------- Destructors ----------
+
+void free_interp(interp *ip);
+
+// ---------- Copy ----------
+
+interp *copy_interp(interp *ip);
+
+// ---------- Run ----------
+
+interp *interp_enter(interp *ip);
+
+void interp_leave(interp *prev);
+
+val *interp_load(interp *ip, char *path);
+
+val *interp_eval(interp *ip, char *input);
+
+val *interp_eval_cost(interp *ip, char *input, cost *c);
+
+// ---------- Allocator ----------
+
+val *val_alloc(val_t type);
+
+void val_release(val *v);
+
+// ---------- Statistics ----------
+
+void stat_lookup(int depth);
+
+void stat_pause(double seconds);
+
+val *stats_list(stats *s);
+
+void fprint_stats(FILE *f, stats *s);
+
+void fprint_time(FILE *f, cost *c);
+
+void fprint_alloc(FILE *f, cost *c);
+
+// ---------- Output ----------
+
+void interp_capture(interp *ip);
+
+char *interp_output(interp *ip, size_t *len);
+
+// ---------- Environment - Interpreter ----------
+
+interp *env_interp(env *e);
+
+#endif
@@ -0,0 +1,779 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "builtin.h"
+#include "types.h"
+#include "interp.h"
+#include "map.h"
+#include "array.h"
+#include "seq.h"
+#include "json.h"
+
+// Nesting limit, so deep documents return an Error instead of overflowing the stack.
+#define JSON_MAX_DEPTH 512
+
+// ---------- Parse ----------
+
+// Position in the text being parsed. The text is a String, so it ends with '\0'.
+typedef struct
+{
+    char *start;
+    char *p;
+    int depth;
+} reader;
+
+static val *parse_error(reader *r, char *what)
+{
+    return new_err("Function 'json-parse' found %s at position %li.", what, (long)(r->p - r->start));
+}
+
+static void skip_space(reader *r)
+{
+    while (*r->p == ' ' || *r->p == '\t' || *r->p == '\n' || *r->p == '\r')
+    {
+        r->p++;
+    }
+}
+
+// String value which takes ownership of s. Short texts are copied into the val instead (see STR_INLINE).
+static val *own_str(char *s)
+{
+    if (strlen(s) <= STR_INLINE)
+    {
+        val *v = new_str(s);
+        free(s);
+        return v;
+    }
+
+    val *v = val_alloc(T_STR);
+    *v = (val){.type = T_STR, .d.str = s};
+    STAT_ADD(bytes, strlen(s) + 1);
+    return v;
+}
+
+static int hex4(char *p)
+{
+    int n = 0;
+
+    for (int i = 0; i < 4; i++)
+    {
+        char c = p[i];
+        n <<= 4;
+
+        if (c >= '0' && c <= '9')
+        {
+            n |= c - '0';
+        }
+        else if (c >= 'a' && c <= 'f')
+        {
+            n |= c - 'a' + 10;
+        }
+        else if (c >= 'A' && c <= 'F')
+        {
+            n |= c - 'A' + 10;
+        }
+        else
+        {
+            return -1;
+        }
+    }
+
+    return n;
+}
+
+static char *put_utf8(char *w, long c)
+{
+    if (c < 0x80)
+    {
+        *w++ = c;
+    }
+    else if (c < 0x800)
+    {
+        *w++ = 0xC0 | c >> 6;
+        *w++ = 0x80 | (c & 0x3F);
+    }
+    else if (c < 0x10000)
+    {
+        *w++ = 0xE0 | c >> 12;
+        *w++ = 0x80 | (c >> 6 & 0x3F);
+        *w++ = 0x80 | (c & 0x3F);
+    }
+    else
+    {
+        *w++ = 0xF0 | c >> 18;
+        *w++ = 0x80 | (c >> 12 & 0x3F);
+        *w++ = 0x80 | (c >> 6 & 0x3F);
+        *w++ = 0x80 | (c & 0x3F);
+    }
+
+    return w;
+}
+
+// Strings without escapes are copied once. Others are decoded into a buffer as long as the quoted text,
+// since no escape decodes to more bytes than it takes.
+static val *parse_string(reader *r)
+{
+    char *s = ++r->p;
+    char *q = s;
+
+    while (*q != '"' && *q != '\\' && (unsigned char)*q >= 0x20)
+    {
+        q++;
+    }
+
+    if (*q == '"')
+    {
+        char *str = malloc(q - s + 1);
+        memcpy(str, s, q - s);
+        str[q - s] = '\0';
+
+        r->p = q + 1;
+        return own_str(str);
+    }
+
+    while (*q != '"' && *q != '\0')
+    {
+        q += *q == '\\' && q[1] != '\0' ? 2 : 1;
+    }
+
+    char *str = malloc(q - s + 1);
+    char *w = str;
+
+    for (;;)
+    {
+        unsigned char c = *r->p;
+
+        if (c == '"')
+        {
+            r->p++;
+            break;
+        }
+        if (c == '\0')
+        {
+            free(str);
+            return parse_error(r, "an unterminated String");
+        }
+        if (c < 0x20)
+        {
+            free(str);
+            return parse_error(r, "a control character in a String");
+        }
+        if (c != '\\')
+        {
+            *w++ = c;
+            r->p++;
+            continue;
+        }
+
+        char *esc = r->p++;
+
+        switch (*r->p++)
+        {
+        case '"':
+            *w++ = '"';
+            break;
+        case '\\':
+            *w++ = '\\';
+            break;
+        case '/':
+            *w++ = '/';
+            break;
+        case 'b':
+            *w++ = '\b';
+            break;
+        case 'f':
+            *w++ = '\f';
+            break;
+        case 'n':
+            *w++ = '\n';
+            break;
+        case 'r':
+            *w++ = '\r';
+            break;
+        case 't':
+            *w++ = '\t';
+            break;
+        case 'u':
+        {
+            long u = hex4(r->p);
+            r->p += u < 0 ? 0 : 4;
+
+            // Characters outside the Basic Multilingual Plane are a pair of surrogates.
+            if (u >= 0xD800 && u <= 0xDBFF && r->p[0] == '\\' && r->p[1] == 'u')
+            {
+                long lo = hex4(r->p + 2);
+
+                if (lo >= 0xDC00 && lo <= 0xDFFF)
+                {
+                    u = 0x10000 + ((u - 0xD800) << 10) + (lo - 0xDC00);
+                    r->p += 6;
+                }
+            }
+
+            if (u <= 0 || (u >= 0xD800 && u <= 0xDFFF))
+            {
+                r->p = esc;
+                free(str);
+                return parse_error(r, u == 0 ? "a NUL character in a String" : "an invalid \\u escape");
+            }
+
+            w = put_utf8(w, u);
+            break;
+        }
+        default:
+            r->p = esc;
+            free(str);
+            return parse_error(r, "an invalid escape");
+        }
+    }
+
+    *w = '\0';
+
+    return own_str(realloc(str, w - str + 1));
+}
+
+// Numbers without a fraction or exponent are Integers, unless they overflow.
+static val *parse_number(reader *r)
+{
+    char *s = r->p;
+    char *p = s;
+    int integer = 1;
+
+    if (*p == '-')
+    {
+        p++;
+    }
+    if (*p == '0')
+    {
+        p++;
+    }
+    else if (*p >= '1' && *p <= '9')
+    {
+        while (*p >= '0' && *p <= '9')
+        {
+            p++;
+        }
+    }
+    else
+    {
+        return parse_error(r, "an invalid value");
+    }
+
+    if (*p == '.')
+    {
+        integer = 0;
+        p++;
+
+        if (!(*p >= '0' && *p <= '9'))
+        {
+            r->p = p;
+            return parse_error(r, "an invalid Number");
+        }
+        while (*p >= '0' && *p <= '9')
+        {
+            p++;
+        }
+    }
+
+    if (*p == 'e' || *p == 'E')
+    {
+        integer = 0;
+        p++;
+
+        if (*p == '+' || *p == '-')
+        {
+            p++;
+        }
+        if (!(*p >= '0' && *p <= '9'))
+        {
+            r->p = p;
+            return parse_error(r, "an invalid Number");
+        }
+        while (*p >= '0' && *p <= '9')
+        {
+            p++;
+        }
+    }
+
+    r->p = p;
+
+    if (integer)
+    {
+        errno = 0;
+        long n = strtol(s, NULL, 10);
+
+        if (errno == 0)
+        {
+            return new_int(n);
+        }
+    }
+
+    return new_flt(strtod(s, NULL));
+}
+
+static val *parse_value(reader *r);
+
+static val *parse_array(reader *r)
+{
+    val *l = new_lst();
+
+    r->p++;
+    skip_space(r);
+
+    if (*r->p == ']')
+    {
+        r->p++;
+        return l;
+    }
+
+    for (;;)
+    {
+        val *x = parse_value(r);
+
+        if (x->type == T_ERR)
+        {
+            free_val(l);
+            return x;
+        }
+
+        exp_add(l, x);
+
+        skip_space(r);
+
+        if (*r->p == ',')
+        {
+            r->p++;
+            continue;
+        }
+        if (*r->p == ']')
+        {
+            r->p++;
+            break;
+        }
+
+        free_val(l);
+        return parse_error(r, "a missing ',' or ']'");
+    }
+
+    return l;
+}
+
+static val *parse_object(reader *r)
+{
+    val *m = new_map();
+
+    r->p++;
+    skip_space(r);
+
+    if (*r->p == '}')
+    {
+        r->p++;
+        return m;
+    }
+
+    for (;;)
+    {
+        skip_space(r);
+
+        if (*r->p != '"')
+        {
+            free_val(m);
+            return parse_error(r, "a key which is not a String");
+        }
+
+        val *key = parse_string(r);
+
+        if (key->type == T_ERR)
+        {
+            free_val(m);
+            return key;
+        }
+
+        skip_space(r);
+
+        if (*r->p != ':')
+        {
+            free_val(key);
+            free_val(m);
+            return parse_error(r, "a missing ':'");
+        }
+
+        r->p++;
+
+        val *x = parse_value(r);
+
+        if (x->type == T_ERR)
+        {
+            free_val(key);
+            free_val(m);
+            return x;
+        }
+
+        map_put(m->d.map, key, x);
+
+        skip_space(r);
+
+        if (*r->p == ',')
+        {
+            r->p++;
+            continue;
+        }
+        if (*r->p == '}')
+        {
+            r->p++;
+            break;
+        }
+
+        free_val(m);
+        return parse_error(r, "a missing ',' or '}'");
+    }
+
+    return m;
+}
+
+static val *parse_value(reader *r)
+{
+    skip_space(r);
+
+    switch (*r->p)
+    {
+    case '{':
+    case '[':
+    {
+        if (r->depth == JSON_MAX_DEPTH)
+        {
+            return parse_error(r, "nesting deeper than 512 levels");
+        }
+
+        r->depth++;
+        val *x = *r->p == '{' ? parse_object(r) : parse_array(r);
+        r->depth--;
+
+        return x;
+    }
+    case '"':
+        return parse_string(r);
+    case 't':
+        if (strncmp(r->p, "true", 4) == 0)
+        {
+            r->p += 4;
+            return new_int(1);
+        }
+        break;
+    case 'f':
+        if (strncmp(r->p, "false", 5) == 0)
+        {
+            r->p += 5;
+            return new_int(0);
+        }
+        break;
+    case 'n':
+        if (strncmp(r->p, "null", 4) == 0)
+        {
+            r->p += 4;
+            return new_lst();
+        }
+        break;
+    case '\0':
+        return parse_error(r, "the end of the text");
+    default:
+        return parse_number(r);
+    }
+
+    return parse_error(r, "an invalid value");
+}
+
+// ---------- Dump ----------
+
+// Output buffer, grown by doubling. 'err' is set by the first value which can't be written.
+typedef struct
+{
+    char *data;
+    long len;
+    long cap;
+
+    env *e;
+    val *err;
+} writer;
+
+static void put(writer *w, char *s, long n)
+{
+    if (w->len + n + 1 > w->cap)
+    {
+        while (w->len + n + 1 > w->cap)
+        {
+            w->cap *= 2;
+        }
+        w->data = realloc(w->data, w->cap);
+    }
+
+    memcpy(w->data + w->len, s, n);
+    w->len += n;
+}
+
+static void put_char(writer *w, char c)
+{
+    put(w, &c, 1);
+}
+
+static void put_int(writer *w, long n)
+{
+    char num[32];
+    put(w, num, snprintf(num, sizeof(num), "%ld", n));
+}
+
+// Shortest form which reads back as the same Float, with a '.' or exponent so it reads back as a Float.
+static int put_flt(writer *w, double n)
+{
+    if (!isfinite(n))
+    {
+        w->err = new_err("Function 'json-dump' passed a Float which is not finite.");
+        return -1;
+    }
+
+    char num[40];
+    int len = snprintf(num, sizeof(num), "%.15g", n);
+
+    if (strtod(num, NULL) != n)
+    {
+        len = snprintf(num, sizeof(num), "%.17g", n);
+    }
+    if (strpbrk(num, ".eE") == NULL)
+    {
+        len += snprintf(num + len, sizeof(num) - len, ".0");
+    }
+
+    put(w, num, len);
+    return 0;
+}
+
+static void put_string(writer *w, char *s)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    put_char(w, '"');
+
+    for (;;)
+    {
+        // Copy runs of characters which need no escape at once.
+        char *run = s;
+
+        while ((unsigned char)*s >= 0x20 && *s != '"' && *s != '\\')
+        {
+            s++;
+        }
+
+        put(w, run, s - run);
+
+        if (*s == '\0')
+        {
+            break;
+        }
+
+        char esc[7] = {'\\', *s, '\0'};
+        int n = 2;
+
+        switch (*s)
+        {
+        case '\b':
+            esc[1] = 'b';
+            break;
+        case '\f':
+            esc[1] = 'f';
+            break;
+        case '\n':
+            esc[1] = 'n';
+            break;
+        case '\r':
+            esc[1] = 'r';
+            break;
+        case '\t':
+            esc[1] = 't';
+            break;
+        case '"':
+        case '\\':
+            break;
+        default:
+            memcpy(esc + 1, "u00", 3);
+            esc[4] = hex[(unsigned char)*s >> 4];
+            esc[5] = hex[*s & 0xF];
+            n = 6;
+        }
+
+        put(w, esc, n);
+        s++;
+    }
+
+    put_char(w, '"');
+}
+
+static int dump(writer *w, val *v);
+
+static int dump_list(writer *w, val *l)
+{
+    put_char(w, '[');
+
+    for (int i = 0; i < l->d.exp.count; i++)
+    {
+        if (i)
+        {
+            put_char(w, ',');
+        }
+        if (dump(w, l->d.exp.list[i]))
+        {
+            return -1;
+        }
+    }
+
+    put_char(w, ']');
+    return 0;
+}
+
+static int dump_map(writer *w, map *m)
+{
+    int first = 1;
+
+    put_char(w, '{');
+
+    for (int i = 0; i < m->cap; i++)
+    {
+        if (m->keys[i] == NULL)
+        {
+            continue;
+        }
+
+        if (m->keys[i]->type != T_STR)
+        {
+            w->err = new_err("Function 'json-dump' passed a Map with a key of type %s. Expected String.", type_name(m->keys[i]->type));
+            return -1;
+        }
+
+        if (!first)
+        {
+            put_char(w, ',');
+        }
+        first = 0;
+
+        put_string(w, m->keys[i]->d.str);
+        put_char(w, ':');
+
+        if (dump(w, m->vals[i]))
+        {
+            return -1;
+        }
+    }
+
+    put_char(w, '}');
+    return 0;
+}
+
+static int dump(writer *w, val *v)
+{
+    switch (v->type)
+    {
+    case T_INT:
+        put_int(w, v->d.intg);
+        return 0;
+    case T_FLT:
+        return put_flt(w, v->d.flt);
+    case T_STR:
+        put_string(w, v->d.str);
+        return 0;
+    case T_LST:
+        return dump_list(w, v);
+    case T_MAP:
+        return dump_map(w, v->d.map);
+    case T_F64ARR:
+    case T_I64ARR:
+        put_char(w, '[');
+
+        for (int i = 0; i < v->d.arr->count; i++)
+        {
+            if (i)
+            {
+                put_char(w, ',');
+            }
+            if (v->type == T_I64ARR)
+            {
+                put_int(w, ((long *)v->d.arr->data)[i]);
+            }
+            else if (put_flt(w, ((double *)v->d.arr->data)[i]))
+            {
+                return -1;
+            }
+        }
+
+        put_char(w, ']');
+        return 0;
+    case T_SEQ:
+    {
+        val *l = seq_to_list(v->d.seq, w->e);
+
+        if (l->type == T_ERR)
+        {
+            w->err = l;
+            return -1;
+        }
+
+        int r = dump_list(w, l);
+        free_val(l);
+        return r;
+    }
+    default:
+        w->err = new_err("Function 'json-dump' has no JSON form for type %s.", type_name(v->type));
+        return -1;
+    }
+}
+
+// ---------- Builtins ----------
+
+// Parse JSON text. Objects become Maps, arrays Lists, true and false 1 and 0, and null {}.
+// Numbers without a fraction or exponent become Integers, others Floats.
+val *b_json_parse(env *e, val *v)
+{
+    ASSERT_NUM("json-parse", v, 1);
+    ASSERT_TYPE("json-parse", v, 0, T_STR);
+
+    char *text = v->d.exp.list[0]->d.str;
+    reader r = {.start = text, .p = text, .depth = 0};
+
+    val *x = parse_value(&r);
+
+    if (x->type != T_ERR)
+    {
+        skip_space(&r);
+
+        if (*r.p != '\0')
+        {
+            free_val(x);
+            x = parse_error(&r, "characters after the value");
+        }
+    }
+
+    free_val(v);
+
+    return x;
+}
+
+// Convert a value to JSON text. Accepts Numbers, Strings, Lists, Maps with String keys, Arrays and Sequences.
+val *b_json_dump(env *e, val *v)
+{
+    ASSERT_NUM("json-dump", v, 1);
+
+    writer w = {.data = malloc(256), .len = 0, .cap = 256, .e = e, .err = NULL};
+
+    if (dump(&w, v->d.exp.list[0]))
+    {
+        free(w.data);
+        free_val(v);
+        return w.err;
+    }
+
+    w.data[w.len] = '\0';
+
+    free_val(v);
+
+    return own_str(realloc(w.data, w.len + 1));
+}
@@ -0,0 +1,12 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include "types.h"
+
+// ---------- Builtins ----------
+
+val *b_json_parse(env *e, val *v);
+
+val *b_json_dump(env *e, val *v);
+
+#endif
@@ -0,0 +1,436 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "builtin.h"
+#include "types.h"
+#include "map.h"
+
+// Initial number of slots. Always a power of two.
+#define MAP_MIN_CAP 8
+
+// ---------- Create, Free ----------
+
+map *map_new(void)
+{
+    map *m = malloc(sizeof(map));
+    *m = (map){.refs = 1, .count = 0, .cap = 0, .hashes = NULL, .keys = NULL, .vals = NULL};
+    return m;
+}
+
+// Release a reference. The table is freed with its last reference.
+void map_free(map *m)
+{
+    if (__atomic_sub_fetch(&m->refs, 1, __ATOMIC_ACQ_REL) > 0)
+    {
+        return;
+    }
+
+    for (int i = 0; i < m->cap; i++)
+    {
+        if (m->keys[i])
+        {
+            free_val(m->keys[i]);
+            free_val(m->vals[i]);
+        }
+    }
+
+    free(m->hashes);
+    free(m->keys);
+    free(m->vals);
+    free(m);
+}
+
+// ---------- Copy ----------
+
+// Add a reference. Copying a Map value is O(1).
+map *map_share(map *m)
+{
+    __atomic_add_fetch(&m->refs, 1, __ATOMIC_RELAXED);
+    return m;
+}
+
+// Return a table that can be changed: the same one if not shared, otherwise a copy.
+map *map_own(map *m)
+{
+    if (__atomic_load_n(&m->refs, __ATOMIC_ACQUIRE) == 1)
+    {
+        return m;
+    }
+
+    map *c = map_new();
+    c->count = m->count;
+    c->cap = m->cap;
+    c->hashes = malloc(sizeof(unsigned long) * m->cap);
+    c->keys = calloc(m->cap, sizeof(val *));
+    c->vals = calloc(m->cap, sizeof(val *));
+
+    for (int i = 0; i < m->cap; i++)
+    {
+        if (m->keys[i])
+        {
+            c->hashes[i] = m->hashes[i];
+            c->keys[i] = copy_val(m->keys[i]);
+            c->vals[i] = copy_val(m->vals[i]);
+        }
+    }
+
+    map_free(m);
+
+    return c;
+}
+
+// ---------- Lookup ----------
+
+// Return the slot of a key, or the empty slot where it would be inserted.
+static int map_slot(map *m, val *key, unsigned long h)
+{
+    int mask = m->cap - 1;
+    int i = h & mask;
+
+    while (m->keys[i] && !(m->hashes[i] == h && val_eq(m->keys[i], key)))
+    {
+        i = (i + 1) & mask;
+    }
+
+    return i;
+}
+
+// Double the number of slots, and reinsert all entries.
+static void map_grow(map *m)
+{
+    int old_cap = m->cap;
+    unsigned long *old_hashes = m->hashes;
+    val **old_keys = m->keys;
+    val **old_vals = m->vals;
+
+    m->cap = old_cap ? old_cap * 2 : MAP_MIN_CAP;
+    m->hashes = malloc(sizeof(unsigned long) * m->cap);
+    m->keys = calloc(m->cap, sizeof(val *));
+    m->vals = calloc(m->cap, sizeof(val *));
+
+    int mask = m->cap - 1;
+
+    for (int i = 0; i < old_cap; i++)
+    {
+        if (old_keys[i])
+        {
+            int j = old_hashes[i] & mask;
+            while (m->keys[j])
+            {
+                j = (j + 1) & mask;
+            }
+
+            m->hashes[j] = old_hashes[i];
+            m->keys[j] = old_keys[i];
+            m->vals[j] = old_vals[i];
+        }
+    }
+
+    free(old_hashes);
+    free(old_keys);
+    free(old_vals);
+}
+
+// ---------- Comparison, Hash ----------
+
+// Maps are equal if they have the same keys, with equal values.
+int map_eq(map *x, map *y)
+{
+    if (x == y)
+    {
+        return 1;
+    }
+
+    if (x->count != y->count)
+    {
+        return 0;
+    }
+
+    for (int i = 0; i < x->cap; i++)
+    {
+        if (x->keys[i])
+        {
+            val *v = map_get(y, x->keys[i]);
+
+            if (v == NULL || !val_eq(x->vals[i], v))
+            {
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+// Independent of the order of entries, like map_eq.
+unsigned long map_hash(map *m)
+{
+    unsigned long h = m->count;
+
+    for (int i = 0; i < m->cap; i++)
+    {
+        if (m->keys[i])
+        {
+            h += m->hashes[i] * 31 + val_hash(m->vals[i]);
+        }
+    }
+
+    return h;
+}
+
+// ---------- Get, Put, Delete ----------
+
+// Return the value of a key, or NULL if not found. The value is still owned by the table.
+val *map_get(map *m, val *key)
+{
+    if (m->count == 0)
+    {
+        return NULL;
+    }
+
+    int i = map_slot(m, key, val_hash(key));
+
+    return m->keys[i] ? m->vals[i] : NULL;
+}
+
+// Set the value of a key. Takes ownership of both. The table must not be shared.
+void map_put(map *m, val *key, val *v)
+{
+    // Keep load factor under 3/4.
+    if ((m->count + 1) * 4 > m->cap * 3)
+    {
+        map_grow(m);
+    }
+
+    unsigned long h = val_hash(key);
+    int i = map_slot(m, key, h);
+
+    if (m->keys[i])
+    {
+        free_val(key);
+        free_val(m->vals[i]);
+        m->vals[i] = v;
+        return;
+    }
+
+    m->hashes[i] = h;
+    m->keys[i] = key;
+    m->vals[i] = v;
+    m->count++;
+}
+
+// Remove a key. Returns 1 if found. The table must not be shared.
+int map_del(map *m, val *key)
+{
+    if (m->count == 0)
+    {
+        return 0;
+    }
+
+    int mask = m->cap - 1;
+    int i = map_slot(m, key, val_hash(key));
+
+    if (!m->keys[i])
+    {
+        return 0;
+    }
+
+    free_val(m->keys[i]);
+    free_val(m->vals[i]);
+    m->keys[i] = NULL;
+    m->count--;
+
+    // Shift back following entries of the probe sequence, so lookups never stop early at the hole.
+    for (int j = (i + 1) & mask; m->keys[j]; j = (j + 1) & mask)
+    {
+        int home = m->hashes[j] & mask;
+
+        // Move entry j into the hole, unless its home slot lies cyclically in (i, j].
+        if ((j > i && (home <= i || home > j)) || (j < i && (home <= i && home > j)))
+        {
+            m->hashes[i] = m->hashes[j];
+            m->keys[i] = m->keys[j];
+            m->vals[i] = m->vals[j];
+            m->keys[j] = NULL;
+            i = j;
+        }
+    }
+
+    return 1;
+}
+
+// ---------- Print ----------
+
+// Print as an Expression which creates the same Map: (map-new key value ...), or (map-new {}) if empty.
+char *map_to_str(map *m)
+{
+    int len = strlen("(map-new");
+    char *str = malloc(len + 5);
+    strcpy(str, "(map-new");
+
+    for (int i = 0; i < m->cap; i++)
+    {
+        if (m->keys[i])
+        {
+            char *k = val_to_str(m->keys[i]);
+            char *v = val_to_str(m->vals[i]);
+
+            str = realloc(str, len + strlen(k) + strlen(v) + 4);
+            len += sprintf(str + len, " %s %s", k, v);
+
+            free(k);
+            free(v);
+        }
+    }
+
+    // Called with no arguments, an Expression evaluates to the Function itself.
+    strcpy(str + len, m->count ? ")" : " {})");
+
+    return str;
+}
+
+// ---------- Builtins ----------
+
+// Create a Map. Accepts key-value pairs, or a single List of key-value pairs ('(map-new {})' for an empty Map).
+val *b_map_new(env *e, val *v)
+{
+    if (v->d.exp.count == 1 && v->d.exp.list[0]->type == T_LST)
+    {
+        val *l = exp_take(v, 0);
+        l->type = T_EXP;
+        v = l;
+    }
+
+    ASSERT(v, v->d.exp.count % 2 == 0,
+        "Function 'map-new' passed incorrect number of arguments. Got %i, Expected key-value pairs.", v->d.exp.count);
+
+    val *m = new_map();
+
+    while (v->d.exp.count)
+    {
+        val *key = exp_pop(v, 0);
+        map_put(m->d.map, key, exp_pop(v, 0));
+    }
+
+    free_val(v);
+
+    return m;
+}
+
+// Return the value of a key in a Map. Accepts a Map, a key, and an optional default value returned if the key is missing.
+val *b_map_get(env *e, val *v)
+{
+    ASSERT(v, v->d.exp.count == 2 || v->d.exp.count == 3,
+        "Function 'map-get' passed incorrect number of arguments. Got %i, Expected 2 or 3.", v->d.exp.count);
+    ASSERT_TYPE("map-get", v, 0, T_MAP);
+
+    val *x = map_get(v->d.exp.list[0]->d.map, v->d.exp.list[1]);
+
+    if (x)
+    {
+        x = copy_val(x);
+    }
+    else if (v->d.exp.count == 3)
+    {
+        x = exp_pop(v, 2);
+    }
+    else
+    {
+        char *key = val_to_str(v->d.exp.list[1]);
+        x = new_err("Function 'map-get' key not found: %s.", key);
+        free(key);
+    }
+
+    free_val(v);
+
+    return x;
+}
+
+// Check if a Map has a key. Accepts a Map and a key.
+val *b_map_has(env *e, val *v)
+{
+    ASSERT_NUM("map-has", v, 2);
+    ASSERT_TYPE("map-has", v, 0, T_MAP);
+
+    val *r = new_int(map_get(v->d.exp.list[0]->d.map, v->d.exp.list[1]) != NULL);
+
+    free_val(v);
+
+    return r;
+}
+
+// Set keys of a Map, and return the Map. Accepts a Map, followed by key-value pairs.
+val *b_map_put(env *e, val *v)
+{
+    ASSERT_MIN("map-put", v, 3);
+    ASSERT_TYPE("map-put", v, 0, T_MAP);
+    ASSERT(v, v->d.exp.count % 2 == 1,
+        "Function 'map-put' passed incorrect number of arguments. Got %i, Expected a Map followed by key-value pairs.", v->d.exp.count);
+
+    val *m = exp_pop(v, 0);
+    m->d.map = map_own(m->d.map);
+
+    while (v->d.exp.count)
+    {
+        val *key = exp_pop(v, 0);
+        map_put(m->d.map, key, exp_pop(v, 0));
+    }
+
+    free_val(v);
+
+    return m;
+}
+
+// Remove keys from a Map, and return the Map. Missing keys are ignored. Accepts a Map, followed by keys.
+val *b_map_del(env *e, val *v)
+{
+    ASSERT_MIN("map-del", v, 2);
+    ASSERT_TYPE("map-del", v, 0, T_MAP);
+
+    val *m = exp_pop(v, 0);
+    m->d.map = map_own(m->d.map);
+
+    for (int i = 0; i < v->d.exp.count; i++)
+    {
+        map_del(m->d.map, v->d.exp.list[i]);
+    }
+
+    free_val(v);
+
+    return m;
+}
+
+// Return the keys of a Map in a List.
+val *b_map_keys(env *e, val *v)
+{
+    ASSERT_NUM("map-keys", v, 1);
+    ASSERT_TYPE("map-keys", v, 0, T_MAP);
+
+    map *m = v->d.exp.list[0]->d.map;
+    val *l = new_lst();
+
+    for (int i = 0; i < m->cap; i++)
+    {
+        if (m->keys[i])
+        {
+            exp_add(l, copy_val(m->keys[i]));
+        }
+    }
+
+    free_val(v);
+
+    return l;
+}
+
+// Return the number of keys in a Map.
+val *b_map_len(env *e, val *v)
+{
+    ASSERT_NUM("map-len", v, 1);
+    ASSERT_TYPE("map-len", v, 0, T_MAP);
+
+    val *len = new_int(v->d.exp.list[0]->d.map->count);
+
+    free_val(v);
+
+    return len;
+}
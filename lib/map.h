@@ -0,0 +1,66 @@
+#ifndef MAP_H
+#define MAP_H
+
+#include "types.h"
+
+// Hash table with open addressing (linear probing). Keys are compared with val_eq, and hashed with val_hash.
+// Shared between copies of a Map value, and copied before being changed if shared (copy-on-write).
+struct map
+{
+    int refs;
+
+    int count;
+    int cap;
+
+    unsigned long *hashes;
+    val **keys;
+    val **vals;
+};
+
+// ---------- Create, Free ----------
+
+map *map_new(void);
+
+void map_free(map *m);
+
+// ---------- Copy ----------
+
+map *map_share(map *m);
+
+map *map_own(map *m);
+
+// ---------- Comparison, Hash ----------
+
+int map_eq(map *x, map *y);
+
+unsigned long map_hash(map *m);
+
+// ---------- Get, Put, Delete ----------
+
+val *map_get(map *m, val *key);
+
+void map_put(map *m, val *key, val *v);
+
+int map_del(map *m, val *key);
+
+// ---------- Print ----------
+
+char *map_to_str(map *m);
+
+// ---------- Builtins ----------
+
+val *b_map_new(env *e, val *v);
+
+val *b_map_get(env *e, val *v);
+
+val *b_map_has(env *e, val *v);
+
+val *b_map_put(env *e, val *v);
+
+val *b_map_del(env *e, val *v);
+
+val *b_map_keys(env *e, val *v);
+
+val *b_map_len(env *e, val *v);
+
+#endif
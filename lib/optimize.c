@@ -0,0 +1,449 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+#include "builtin.h"
+#include "map.h"
+#include "optimize.h"
+
+// Most values in the body of an inlined Function.
+#define INLINE_MAX 32
+
+int opt_enabled = 1;
+
+static val *opt_code(optimizer *o, env *e, val *v);
+
+// ---------- Bound Symbols ----------
+
+static int is_bound(optimizer *o, char *name)
+{
+    for (int i = 0; i < o->count; i++)
+    {
+        if (strcmp(o->names[i], name) == 0)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void add_bound(optimizer *o, char *name)
+{
+    if (is_bound(o, name))
+    {
+        return;
+    }
+
+    o->names = realloc(o->names, sizeof(char *) * (o->count + 1));
+    o->names[o->count] = malloc(strlen(name) + 1);
+    strcpy(o->names[o->count++], name);
+}
+
+// Collect the Symbols bound in a form, including inside Lists, which may be evaluated later as Function bodies.
+static void scan(optimizer *o, val *v)
+{
+    if (v->type != T_EXP && v->type != T_LST)
+    {
+        return;
+    }
+
+    val *first = v->d.exp.count >= 2 ? v->d.exp.list[0] : NULL;
+
+    if (first && first->type == T_SYM && (strcmp(first->d.str, "def") == 0 || strcmp(first->d.str, "=") == 0 ||
+        strcmp(first->d.str, "fun") == 0 || strcmp(first->d.str, "func") == 0))
+    {
+        val *names = v->d.exp.list[1];
+
+        if (names->type != T_LST)
+        {
+            o->dynamic = 1;
+            return;
+        }
+
+        for (int i = 0; i < names->d.exp.count; i++)
+        {
+            if (names->d.exp.list[i]->type == T_SYM)
+            {
+                add_bound(o, names->d.exp.list[i]->d.str);
+            }
+        }
+    }
+
+    for (int i = 0; i < v->d.exp.count && !o->dynamic; i++)
+    {
+        scan(o, v->d.exp.list[i]);
+    }
+}
+
+// ---------- Constructors ----------
+
+// Create an optimizer for the forms of a file.
+optimizer *new_optimizer(val *forms)
+{
+    optimizer *o = malloc(sizeof(optimizer));
+
+    *o = (optimizer){.count = 0, .names = NULL, .dynamic = 0};
+
+    if (opt_enabled)
+    {
+        scan(o, forms);
+    }
+
+    return o;
+}
+
+// ---------- Destructors ----------
+
+void free_optimizer(optimizer *o)
+{
+    for (int i = 0; i < o->count; i++)
+    {
+        free(o->names[i]);
+    }
+
+    free(o->names);
+    free(o);
+}
+
+// ---------- Definitions ----------
+
+// Return the definition of a Symbol without copying it, or NULL if unknown.
+static val *lookup(env *e, char *name)
+{
+    for (; e; e = e->parent)
+    {
+        for (int i = 0; i < e->count; i++)
+        {
+            if (strcmp(e->keys[i], name) == 0)
+            {
+                return e->vals[i];
+            }
+        }
+    }
+
+    return NULL;
+}
+
+// Return the builtin a Symbol is defined as, if the forms never rebind it. Otherwise, NULL.
+static builtin known_builtin(optimizer *o, env *e, val *sym)
+{
+    if (sym->type != T_SYM || is_bound(o, sym->d.str))
+    {
+        return NULL;
+    }
+
+    val *f = lookup(e, sym->d.str);
+
+    return f && f->type == T_FUN ? f->d.fun.blt : NULL;
+}
+
+// Whether a builtin has any of the flags of the registry: BLT_FOLD for builtins folded when all arguments are
+// literals, BLT_PURE for other builtins without side effects. Only these may be called by an inlined Function.
+static int has_flag(builtin blt, int flags)
+{
+    builtin_info *b = blt ? builtin_entry(blt) : NULL;
+
+    return b && (b->flags & flags);
+}
+
+static int is_literal(val *x)
+{
+    return x->type == T_INT || x->type == T_FLT || x->type == T_STR;
+}
+
+// Whether element i of an Expression calling first is a List evaluated as code: the body of 'fun' or 'func',
+// or a branch of 'if'.
+static int is_body(optimizer *o, env *e, val *first, builtin blt, int i)
+{
+    if (blt)
+    {
+        return (blt == b_fun && i == 2) || (blt == b_if && i >= 2);
+    }
+
+    if (i != 2 || first->type != T_SYM || strcmp(first->d.str, "func") != 0 || is_bound(o, "func"))
+    {
+        return 0;
+    }
+
+    val *f = lookup(e, "func");
+
+    return f && f->type == T_FUN && !f->d.fun.blt;
+}
+
+// ---------- Folding ----------
+
+// Evaluate a call of a builtin without side effects on literals. Kept as is if the result is an Error, so it is
+// reported when the form runs.
+static val *fold(env *e, builtin blt, val *v)
+{
+    val *args = copy_val(v);
+    free_val(exp_pop(args, 0));
+
+    val *r = blt(e, args);
+
+    if (!is_literal(r))
+    {
+        free_val(r);
+        return v;
+    }
+
+    free_val(v);
+    return r;
+}
+
+// ---------- Inlining ----------
+
+static int param_index(val *header, char *name)
+{
+    for (int i = 0; i < header->d.exp.count; i++)
+    {
+        if (strcmp(header->d.exp.list[i]->d.str, name) == 0)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+// Whether a Function body can replace its calls: it only contains literals, calls of builtins without side
+// effects, and each parameter exactly once, in order, so arguments are still evaluated once and in order.
+static int can_inline(optimizer *o, env *e, val *header, val *body, int *next, int *size)
+{
+    for (int i = 0; i < body->d.exp.count; i++)
+    {
+        val *x = body->d.exp.list[i];
+
+        if (++*size > INLINE_MAX)
+        {
+            return 0;
+        }
+
+        if (x->type == T_SYM)
+        {
+            int p = param_index(header, x->d.str);
+
+            if (p >= 0 && p != (*next)++)
+            {
+                return 0;
+            }
+
+            builtin blt = p < 0 ? known_builtin(o, e, x) : NULL;
+
+            if (p < 0 && !has_flag(blt, BLT_FOLD | BLT_PURE))
+            {
+                return 0;
+            }
+        }
+        else if (x->type == T_EXP)
+        {
+            if (x->d.exp.count == 0 || !can_inline(o, e, header, x, next, size))
+            {
+                return 0;
+            }
+        }
+        else if (!is_literal(x))
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+// Copy a Function body as an Expression, with parameters replaced by the arguments of a call.
+static val *substitute(val *body, val *header, val *call)
+{
+    val *r = new_exp();
+
+    for (int i = 0; i < body->d.exp.count; i++)
+    {
+        val *x = body->d.exp.list[i];
+        int p = x->type == T_SYM ? param_index(header, x->d.str) : -1;
+
+        if (p >= 0)
+        {
+            r = exp_add(r, copy_val(call->d.exp.list[p + 1]));
+        }
+        else if (x->type == T_EXP)
+        {
+            r = exp_add(r, substitute(x, header, call));
+        }
+        else
+        {
+            r = exp_add(r, copy_val(x));
+        }
+    }
+
+    return r;
+}
+
+// Replace a call of a small Function defined outside the forms (e.g. by the standard library) with its body.
+static val *inline_call(optimizer *o, env *e, val *v)
+{
+    val *first = v->d.exp.list[0];
+
+    if (first->type != T_SYM || is_bound(o, first->d.str))
+    {
+        return v;
+    }
+
+    val *f = lookup(e, first->d.str);
+
+    // Functions with arguments already given, or taken from a module, depend on their environment.
+    if (f == NULL || f->type != T_FUN || f->d.fun.blt || f->d.fun.env->count || f->d.fun.env->parent)
+    {
+        return v;
+    }
+
+    val *header = f->d.fun.header;
+    val *body = f->d.fun.body;
+
+    if (header->d.exp.count != v->d.exp.count - 1 || body->d.exp.count == 0)
+    {
+        return v;
+    }
+
+    for (int i = 0; i < header->d.exp.count; i++)
+    {
+        if (header->d.exp.list[i]->type != T_SYM || strcmp(header->d.exp.list[i]->d.str, "&") == 0)
+        {
+            return v;
+        }
+    }
+
+    int next = 0;
+    int size = 0;
+
+    if (!can_inline(o, e, header, body, &next, &size) || next != header->d.exp.count)
+    {
+        return v;
+    }
+
+    val *r = substitute(body, header, v);
+
+    // An Expression of one value evaluates to the value.
+    if (r->d.exp.count == 1)
+    {
+        r = exp_take(r, 0);
+    }
+
+    // The body only calls builtins, so this folds it without inlining further.
+    r = opt_code(o, e, r);
+
+    // Guard the body with the definition it was taken from, and keep the call for when it changes.
+    val *guard = exp_add(exp_add(new_lst(), copy_val(first)), copy_val(f));
+
+    val *g = exp_add(new_exp(), new_builtin_fun(b_inlined));
+    exp_add(g, guard);
+    exp_add(g, r->type == T_EXP ? r : exp_add(new_exp(), r));
+    exp_add(g, v);
+
+    g->d.exp.list[2]->type = T_LST;
+    v->type = T_LST;
+
+    return g;
+}
+
+// Choose the code of an inlined call, whose List of the Symbol called and its definition when inlined is at index
+// i, followed by the inlined body and the call as written. The body is only chosen while the Symbol still names the
+// same definition here, since Functions may be redefined, or shadowed by a local of a caller, after the call was
+// optimized. Frees the rest of the call.
+val *inlined_code(env *e, val *v, int i)
+{
+    val *guard = v->d.exp.list[i];
+    val *f = guard->d.exp.list[1];
+    val *now = env_find(e, guard->d.exp.list[0]);
+
+    int same = now && now->type == T_FUN && !now->d.fun.blt &&
+        now->d.fun.body->d.exp.list == f->d.fun.body->d.exp.list && now->d.fun.env->count == 0 && !now->d.fun.env->parent;
+
+    val *code = exp_take(v, same ? i + 1 : i + 2);
+    code->type = T_EXP;
+
+    return code;
+}
+
+// Evaluate an inlined call. eval_exp chooses the code before evaluating any arguments, so this is only reached when
+// called some other way, e.g. through eval.
+val *b_inlined(env *e, val *v)
+{
+    return eval(e, inlined_code(e, v, 0));
+}
+
+// ---------- Optimize ----------
+
+// Optimize a List evaluated as code, as the Expression it is evaluated as.
+static val *opt_body(optimizer *o, env *e, val *v)
+{
+    v->type = T_EXP;
+    v = opt_code(o, e, v);
+
+    if (v->type == T_EXP)
+    {
+        v->type = T_LST;
+        return v;
+    }
+
+    return exp_add(new_lst(), v);
+}
+
+static val *opt_code(optimizer *o, env *e, val *v)
+{
+    if (v->type != T_EXP || v->d.exp.count == 0)
+    {
+        return v;
+    }
+
+    exp_own(v);
+    val *first = v->d.exp.list[0];
+    builtin blt = known_builtin(o, e, first);
+
+    int literals = 1;
+
+    for (int i = 1; i < v->d.exp.count; i++)
+    {
+        val *x = v->d.exp.list[i];
+
+        if (x->type == T_EXP)
+        {
+            v->d.exp.list[i] = opt_code(o, e, x);
+        }
+        else if (x->type == T_LST && is_body(o, e, first, blt, i))
+        {
+            v->d.exp.list[i] = opt_body(o, e, x);
+        }
+
+        literals = literals && is_literal(v->d.exp.list[i]);
+    }
+
+    if (first->type == T_EXP)
+    {
+        v->d.exp.list[0] = opt_code(o, e, first);
+        return v;
+    }
+
+    if (v->d.exp.count < 2)
+    {
+        return v;
+    }
+
+    if (blt)
+    {
+        return literals && has_flag(blt, BLT_FOLD) ? fold(e, blt, v) : v;
+    }
+
+    return inline_call(o, e, v);
+}
+
+// Optimize a top-level form, using the definitions of the environment it is about to be evaluated in.
+val *optimize(optimizer *o, env *e, val *v)
+{
+    if (!opt_enabled || o->dynamic)
+    {
+        return v;
+    }
+
+    return opt_code(o, e, v);
+}
@@ -0,0 +1,38 @@
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+#include "types.h"
+
+// Optimizer of the top-level forms of one file (or one input of the prompt), applied before each form is evaluated.
+// Calls of builtins without side effects on literal arguments are folded, and calls of small Functions without
+// side effects are replaced by their body.
+typedef struct
+{
+    // Symbols bound anywhere in the forms, by 'def', '=', 'fun' or 'func'. Never assumed to keep their definition.
+    int count;
+    char **names;
+
+    // Set if the forms bind names computed at run time. Any Symbol may then be rebound, so nothing is optimized.
+    int dynamic;
+} optimizer;
+
+// Cleared by '--no-opt'.
+extern int opt_enabled;
+
+// ---------- Constructors ----------
+
+optimizer *new_optimizer(val *forms);
+
+// ---------- Destructors ----------
+
+void free_optimizer(optimizer *o);
+
+// ---------- Optimize ----------
+
+val *optimize(optimizer *o, env *e, val *v);
+
+val *inlined_code(env *e, val *v, int i);
+
+val *b_inlined(env *e, val *v);
+
+#endif
@@ -0,0 +1,281 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "builtin.h"
+#include "types.h"
+#include "pool.h"
+#include "parallel.h"
+
+// Number of tasks per thread. More tasks than threads lets idle threads steal work from slow ones.
+#define TASKS_PER_THREAD 8
+
+typedef enum
+{
+    P_MAP,
+    P_FILTER,
+    P_REDUCE
+} pjob_t;
+
+// Work shared by the threads of a parallel builtin.
+// Threads only read the function, the List, and the environment, and write their own results.
+typedef struct
+{
+    pjob_t type;
+
+    env *e;
+    val *f;
+    val *l;
+
+    // Elements per task.
+    int chunk;
+
+    // Result of each element (map, filter), or of each task (reduce).
+    val **results;
+} pjob;
+
+// Call a function with arguments. The function is copied, since calling consumes its header.
+static val *papply(env *e, val *f, val *args)
+{
+    val *fc = copy_val(f);
+    val *r = call(e, fc, args);
+    free_val(fc);
+    return r;
+}
+
+// Run one task: apply the function to a chunk of the List.
+static void pjob_task(void *ctx, int t)
+{
+    pjob *j = ctx;
+
+    int start = t * j->chunk;
+    int end = start + j->chunk < j->l->d.exp.count ? start + j->chunk : j->l->d.exp.count;
+    val **items = j->l->d.exp.list;
+
+    // Scratch environment of the task. Definitions made by the function stop here,
+    // so the shared environment is never written.
+    env *te = new_env();
+    te->parent = j->e;
+    te->module = 1;
+
+    if (j->type == P_REDUCE)
+    {
+        val *acc = copy_val(items[start]);
+
+        for (int i = start + 1; i < end && acc->type != T_ERR; i++)
+        {
+            acc = papply(te, j->f, exp_add(exp_add(new_exp(), acc), copy_val(items[i])));
+        }
+
+        j->results[t] = acc;
+    }
+    else
+    {
+        for (int i = start; i < end; i++)
+        {
+            j->results[i] = papply(te, j->f, exp_add(new_exp(), copy_val(items[i])));
+        }
+    }
+
+    free_env(te);
+}
+
+// Split the List of arguments (function, List) into tasks, and run them on the thread pool.
+// Returns the number of results, or 0 if the List is empty.
+static int pjob_run(pjob *j, env *e, val *f, val *l)
+{
+    int n = l->d.exp.count;
+
+    if (n == 0)
+    {
+        return 0;
+    }
+
+    int threads = pool_threads();
+    int chunk = n / (threads * TASKS_PER_THREAD);
+    chunk = chunk > 0 ? chunk : 1;
+    int tasks = (n + chunk - 1) / chunk;
+
+    j->e = e;
+    j->f = f;
+    j->l = l;
+    j->chunk = chunk;
+    j->results = malloc(sizeof(val *) * (j->type == P_REDUCE ? tasks : n));
+
+    pool_for(threads, tasks, pjob_task, j);
+
+    return j->type == P_REDUCE ? tasks : n;
+}
+
+// Return the first Error of the results, and free all others. Returns NULL if there are no Errors.
+static val *pjob_error(val **results, int n)
+{
+    val *err = NULL;
+
+    for (int i = 0; i < n; i++)
+    {
+        if (results[i]->type == T_ERR && err == NULL)
+        {
+            err = results[i];
+            continue;
+        }
+
+        if (err)
+        {
+            free_val(results[i]);
+        }
+    }
+
+    if (err)
+    {
+        for (int i = 0; results[i] != err; i++)
+        {
+            free_val(results[i]);
+        }
+    }
+
+    return err;
+}
+
+// Apply a function to each element of a List, in parallel. Accepts a Function and a List.
+// The function should be pure, since it runs on several threads at once.
+val *b_pmap(env *e, val *v)
+{
+    ASSERT_NUM("pmap", v, 2);
+    ASSERT_TYPE("pmap", v, 0, T_FUN);
+    ASSERT_TYPE("pmap", v, 1, T_LST);
+
+    pjob j = {.type = P_MAP};
+    int n = pjob_run(&j, e, v->d.exp.list[0], v->d.exp.list[1]);
+
+    free_val(v);
+
+    val *l = new_lst();
+
+    if (n == 0)
+    {
+        return l;
+    }
+
+    val *err = pjob_error(j.results, n);
+
+    if (err)
+    {
+        free(j.results);
+        free_val(l);
+        return err;
+    }
+
+    exp_reserve(l, n);
+    memcpy(l->d.exp.list, j.results, sizeof(val *) * n);
+    l->d.exp.count = n;
+    free(j.results);
+
+    return l;
+}
+
+// Keep the elements of a List for which a function returns true, in parallel. Accepts a Function and a List.
+val *b_pfilter(env *e, val *v)
+{
+    ASSERT_NUM("pfilter", v, 2);
+    ASSERT_TYPE("pfilter", v, 0, T_FUN);
+    ASSERT_TYPE("pfilter", v, 1, T_LST);
+
+    pjob j = {.type = P_FILTER};
+    int n = pjob_run(&j, e, v->d.exp.list[0], v->d.exp.list[1]);
+
+    val *l = exp_take(v, 1);
+    exp_own(l);
+
+    if (n == 0)
+    {
+        return l;
+    }
+
+    val *err = NULL;
+
+    for (int i = 0; i < n && !err; i++)
+    {
+        if (j.results[i]->type == T_ERR)
+        {
+            err = copy_val(j.results[i]);
+        }
+        else if (j.results[i]->type != T_INT)
+        {
+            err = new_err("Function 'pfilter' expects the function to return an Integer. Got %s.", type_name(j.results[i]->type));
+        }
+    }
+
+    val *r = new_lst();
+
+    for (int i = 0; i < n; i++)
+    {
+        if (!err && j.results[i]->d.intg)
+        {
+            exp_add(r, l->d.exp.list[i]);
+        }
+        else
+        {
+            free_val(l->d.exp.list[i]);
+        }
+
+        free_val(j.results[i]);
+    }
+
+    // Elements are now owned by the result, or freed.
+    l->d.exp.count = 0;
+    free_val(l);
+    free(j.results);
+
+    if (err)
+    {
+        free_val(r);
+        return err;
+    }
+
+    return r;
+}
+
+// Fold a List with an associative function, in parallel. Accepts a Function, an initial value, and a List.
+// Each task folds its chunk, then the results of the tasks are folded in order, starting from the initial value.
+val *b_preduce(env *e, val *v)
+{
+    ASSERT_NUM("preduce", v, 3);
+    ASSERT_TYPE("preduce", v, 0, T_FUN);
+    ASSERT_TYPE("preduce", v, 2, T_LST);
+
+    pjob j = {.type = P_REDUCE};
+    int n = pjob_run(&j, e, v->d.exp.list[0], v->d.exp.list[2]);
+
+    val *f = exp_pop(v, 0);
+    val *acc = exp_take(v, 0);
+
+    if (n > 0)
+    {
+        val *err = pjob_error(j.results, n);
+
+        if (err)
+        {
+            free_val(acc);
+            acc = err;
+        }
+        else
+        {
+            for (int i = 0; i < n; i++)
+            {
+                if (acc->type == T_ERR)
+                {
+                    free_val(j.results[i]);
+                    continue;
+                }
+
+                acc = papply(e, f, exp_add(exp_add(new_exp(), acc), j.results[i]));
+            }
+        }
+
+        free(j.results);
+    }
+
+    free_val(f);
+
+    return acc;
+}
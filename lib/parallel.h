@@ -0,0 +1,12 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "types.h"
+
+val *b_pmap(env *e, val *v);
+
+val *b_pfilter(env *e, val *v);
+
+val *b_preduce(env *e, val *v);
+
+#endif
@@ -1,3 +1,5 @@
+#define _XOPEN_SOURCE 700
+
 #include <limits.h>
 #include <float.h>
 
@@ -5,6 +7,47 @@
 
 #include "types.h"
 #include "parser.h"
+#include "cache.h"
+#include "optimize.h"
+
+#ifdef _WIN32
+#define realpath(path, resolved) _fullpath(NULL, path, 0)
+#endif
+
+// Create parsers, and define the grammar rules.
+grammar *new_grammar(void)
+{
+    grammar *g = malloc(sizeof(grammar));
+
+    g->number = mpc_new("number");
+    g->string = mpc_new("string");
+    g->symbol = mpc_new("symbol");
+    g->expression = mpc_new("expression");
+    g->list = mpc_new("list");
+    g->component = mpc_new("component");
+    g->comment = mpc_new("comment");
+    g->parser = mpc_new("parser");
+
+    mpca_lang(MPCA_LANG_DEFAULT,
+    "                                                                                       \
+        number      : /-?[0-9]+\\.?[0-9]*/ ;                                                \
+        string      : /\"(\\\\.|[^\"])*\"/ ;                                                \
+        symbol      : /[a-zA-Z0-9|^%_+\\-*\\/\\\\=<>!&]+/ ;                                  \
+        expression  : '(' <component>* ')' ;                                                \
+        list        : '{' <component>* '}' ;                                                \
+        component   : <number> | <string> | <symbol> | <expression> | <list> | <comment> ;  \
+        comment     : /;[^\\r\\n]*/ ;                                                       \
+        parser      : /^/ <component>* /$/ ;                                                \
+    ", g->number, g->string, g->symbol, g->expression, g->list, g->component, g->comment, g->parser);
+
+    return g;
+}
+
+void free_grammar(grammar *g)
+{
+    mpc_cleanup(8, g->number, g->string, g->symbol, g->expression, g->list, g->component, g->comment, g->parser);
+    free(g);
+}
 
 // Parse input, evalute, and return val result.
 val *parse(char *input, mpc_parser_t *parser, env *e)
@@ -16,9 +59,13 @@ val *parse(char *input, mpc_parser_t *parser, env *e)
         mpc_ast_t *node = r.output;
         // mpc_ast_print(node);
 
-        val *v = eval(e, parse_node(node));
+        val *v = parse_node(node);
         mpc_ast_delete(node);
 
+        optimizer *o = new_optimizer(v);
+        v = eval(e, optimize(o, e, v));
+        free_optimizer(o);
+
         return v;
     }
     else
@@ -29,6 +76,82 @@ val *parse(char *input, mpc_parser_t *parser, env *e)
     }
 }
 
+// Read a whole file into a NUL-terminated buffer. Returns NULL if it can't be read. Result must be freed.
+char *read_file(char *path, long *len)
+{
+    FILE *f = fopen(path, "rb");
+
+    if (f == NULL)
+    {
+        return NULL;
+    }
+
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    char *src = malloc(*len + 1);
+
+    if (fread(src, 1, *len, f) != (size_t)*len)
+    {
+        free(src);
+        fclose(f);
+        return NULL;
+    }
+
+    src[*len] = '\0';
+    fclose(f);
+
+    return src;
+}
+
+// Return the absolute path of a file with all links resolved, or NULL if it doesn't exist. Result must be freed.
+char *canonical_path(char *path)
+{
+    return realpath(path, NULL);
+}
+
+// Parse a file, and return its top-level Components in an Expression, or Error if failed.
+// Unchanged files are read from the module cache (if enabled), skipping parsing entirely.
+val *parse_file(char *path, mpc_parser_t *parser)
+{
+    long len = 0;
+    char *src = read_file(path, &len);
+
+    if (src == NULL)
+    {
+        return new_err("Failed to load library: Unable to open file '%s'.", path);
+    }
+
+    cache_key key;
+    val *v = cache_read(path, src, len, &key);
+
+    if (v == NULL)
+    {
+        mpc_result_t r;
+
+        if (mpc_nparse(path, src, len, parser, &r))
+        {
+            v = parse_node(r.output);
+            mpc_ast_delete(r.output);
+
+            cache_write(path, &key, v);
+        }
+        else
+        {
+            char *err_msg = mpc_err_string(r.error);
+            mpc_err_delete(r.error);
+
+            v = new_err("Failed to load library: %s", err_msg);
+            free(err_msg);
+        }
+    }
+
+    free(src);
+
+    return v;
+}
+
 // Parse AST node and return val.
 val *parse_node(mpc_ast_t *node)
 {
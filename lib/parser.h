@@ -5,8 +5,31 @@
 
 #include "types.h"
 
+// Parsers of the Z-Lisp grammar. Only read while parsing, so one grammar can be shared by all interpreters.
+typedef struct
+{
+    mpc_parser_t *number;
+    mpc_parser_t *string;
+    mpc_parser_t *symbol;
+    mpc_parser_t *expression;
+    mpc_parser_t *list;
+    mpc_parser_t *component;
+    mpc_parser_t *comment;
+    mpc_parser_t *parser;
+} grammar;
+
+grammar *new_grammar(void);
+
+void free_grammar(grammar *g);
+
 val *parse(char *input, mpc_parser_t *parser, env *e);
 
+char *read_file(char *path, long *len);
+
+char *canonical_path(char *path);
+
+val *parse_file(char *path, mpc_parser_t *parser);
+
 val *parse_node(mpc_ast_t *node);
 
 val *parse_num(mpc_ast_t *node);
@@ -0,0 +1,160 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "pool.h"
+
+// Tasks owned by one worker. The owner takes from the front, other workers steal from the back.
+typedef struct
+{
+    pthread_mutex_t lock;
+
+    int front;
+    int back;
+} deque;
+
+// Shared state of one pool_for call.
+typedef struct
+{
+    pool_task task;
+    void *ctx;
+
+    int threads;
+    deque *queues;
+} pool;
+
+// Argument of a worker thread.
+typedef struct
+{
+    pool *p;
+    int id;
+} worker;
+
+// ---------- Threads ----------
+
+// Return the default number of threads: ZLISP_THREADS if set, otherwise the number of online processors.
+int pool_threads(void)
+{
+    char *env = getenv("ZLISP_THREADS");
+    long n = env ? atol(env) : sysconf(_SC_NPROCESSORS_ONLN);
+
+    return n > 0 ? n : 1;
+}
+
+// ---------- Deque - Take, Steal ----------
+
+// Take the next task from the front of a deque. Returns -1 if empty.
+static int deque_take(deque *q)
+{
+    int i = -1;
+
+    pthread_mutex_lock(&q->lock);
+    if (q->front < q->back)
+    {
+        i = q->front++;
+    }
+    pthread_mutex_unlock(&q->lock);
+
+    return i;
+}
+
+// Steal the last task from the back of a deque. Returns -1 if empty.
+static int deque_steal(deque *q)
+{
+    int i = -1;
+
+    pthread_mutex_lock(&q->lock);
+    if (q->front < q->back)
+    {
+        i = --q->back;
+    }
+    pthread_mutex_unlock(&q->lock);
+
+    return i;
+}
+
+// ---------- Run ----------
+
+static void *pool_worker(void *arg)
+{
+    worker *w = arg;
+    pool *p = w->p;
+
+    while (1)
+    {
+        int i = deque_take(&p->queues[w->id]);
+
+        // Own tasks are done, steal from the others. Tasks never add tasks, so stop once all are empty.
+        for (int k = 1; i < 0 && k < p->threads; k++)
+        {
+            i = deque_steal(&p->queues[(w->id + k) % p->threads]);
+        }
+
+        if (i < 0)
+        {
+            break;
+        }
+
+        p->task(p->ctx, i);
+    }
+
+    return NULL;
+}
+
+// Run task(ctx, i) for each i in [0, count), on up to 'threads' threads. Returns when all are done.
+// Each thread starts with a contiguous range of indices, and steals from the others once it runs out.
+// The calling thread works as one of the threads.
+void pool_for(int threads, int count, pool_task task, void *ctx)
+{
+    if (threads > count)
+    {
+        threads = count;
+    }
+
+    if (threads < 1)
+    {
+        return;
+    }
+
+    pool p = {.task = task, .ctx = ctx, .threads = threads, .queues = malloc(sizeof(deque) * threads)};
+    worker *workers = malloc(sizeof(worker) * threads);
+    pthread_t *ids = malloc(sizeof(pthread_t) * threads);
+
+    for (int i = 0; i < threads; i++)
+    {
+        pthread_mutex_init(&p.queues[i].lock, NULL);
+        p.queues[i].front = (long)count * i / threads;
+        p.queues[i].back = (long)count * (i + 1) / threads;
+
+        workers[i] = (worker){.p = &p, .id = i};
+    }
+
+    int started[threads];
+
+    for (int i = 1; i < threads; i++)
+    {
+        started[i] = pthread_create(&ids[i], NULL, pool_worker, &workers[i]) == 0;
+    }
+
+    // Tasks of threads that failed to start are stolen by the others.
+    pool_worker(&workers[0]);
+
+    for (int i = 1; i < threads; i++)
+    {
+        if (started[i])
+        {
+            pthread_join(ids[i], NULL);
+        }
+    }
+
+    for (int i = 0; i < threads; i++)
+    {
+        pthread_mutex_destroy(&p.queues[i].lock);
+    }
+
+    free(p.queues);
+    free(workers);
+    free(ids);
+}
@@ -0,0 +1,15 @@
+#ifndef POOL_H
+#define POOL_H
+
+// Task run by the pool, for one index.
+typedef void (*pool_task)(void *ctx, int i);
+
+// ---------- Threads ----------
+
+int pool_threads(void);
+
+// ---------- Run ----------
+
+void pool_for(int threads, int count, pool_task task, void *ctx);
+
+#endif
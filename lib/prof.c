@@ -0,0 +1,262 @@
+#define _POSIX_C_SOURCE 200809L
+
+#ifdef ZLISP_PROFILE
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "types.h"
+#include "builtin.h"
+#include "prof.h"
+
+// Longest name kept for a Function without a 'def' name, identified by its text.
+#define PROF_TEXT_LEN 60
+
+// Counters of one function. Updated atomically, since Functions may be called on several threads.
+typedef struct
+{
+    char *name;
+    int builtin;
+
+    // Bound to a name by 'def' or '=', rather than identified by its text.
+    int named;
+
+    long calls;
+    long incl;
+    long excl;
+} prof_entry;
+
+// Call of a function on the stack of a thread. 'child' is the time spent in calls made from it.
+typedef struct
+{
+    int id;
+    long start;
+    long child;
+} prof_frame;
+
+int prof_enabled = 0;
+
+// Entry 0 collects Functions without a name. Entries are never removed, so ids stay valid.
+static prof_entry entries[PROF_MAX] = {{.name = "<anonymous>"}};
+static int entry_count = 1;
+static pthread_mutex_t entry_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static __thread prof_frame *stack = NULL;
+static __thread int depth = 0;
+static __thread int stack_cap = 0;
+
+// Number of calls of each entry on this thread's stack. Inclusive time is only added by the outermost,
+// so recursion is not counted more than once.
+static __thread int *active = NULL;
+
+// ---------- Functions ----------
+
+// Return the id of a function name, adding it if new.
+int prof_intern(char *name, int builtin)
+{
+    pthread_mutex_lock(&entry_lock);
+
+    int id;
+
+    for (id = 1; id < entry_count; id++)
+    {
+        if (entries[id].builtin == builtin && strcmp(entries[id].name, name) == 0)
+        {
+            break;
+        }
+    }
+
+    if (id == entry_count)
+    {
+        if (entry_count == PROF_MAX - 1)
+        {
+            id = PROF_MAX - 1;
+            entries[id].name = "<other>";
+        }
+        else
+        {
+            entries[id].name = malloc(strlen(name) + 1);
+            strcpy(entries[id].name, name);
+            entries[id].builtin = builtin;
+            entry_count++;
+        }
+    }
+
+    pthread_mutex_unlock(&entry_lock);
+
+    return id;
+}
+
+// Identify a new Function by its text, until it is bound to a name.
+void prof_name_fun(val *f)
+{
+    char *header = val_to_str(f->d.fun.header);
+    char *body = val_to_str(f->d.fun.body);
+    char *text = malloc(strlen(header) + strlen(body) + strlen("(fun  )") + 1);
+
+    sprintf(text, "(fun %s %s)", header, body);
+
+    if (strlen(text) > PROF_TEXT_LEN)
+    {
+        strcpy(text + PROF_TEXT_LEN - 3, "...");
+    }
+
+    f->d.fun.prof = prof_intern(text, 0);
+
+    free(text);
+    free(body);
+    free(header);
+}
+
+// Bind a Function to the name it is defined under. Functions already bound keep their name.
+void prof_label_fun(val *f, char *name)
+{
+    if (f->d.fun.blt || entries[f->d.fun.prof].named)
+    {
+        return;
+    }
+
+    f->d.fun.prof = prof_intern(name, 0);
+    entries[f->d.fun.prof].named = 1;
+}
+
+// ---------- Timing ----------
+
+// Monotonic time in nanoseconds.
+static long now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000L + t.tv_nsec;
+}
+
+void prof_enter(int id)
+{
+    if (depth == stack_cap)
+    {
+        stack_cap = stack_cap ? stack_cap * 2 : 256;
+        stack = realloc(stack, sizeof(prof_frame) * stack_cap);
+    }
+    if (active == NULL)
+    {
+        active = calloc(PROF_MAX, sizeof(int));
+    }
+
+    __atomic_add_fetch(&entries[id].calls, 1, __ATOMIC_RELAXED);
+    active[id]++;
+
+    stack[depth++] = (prof_frame){.id = id, .start = now(), .child = 0};
+}
+
+void prof_leave(int id)
+{
+    prof_frame *f = &stack[--depth];
+    long elapsed = now() - f->start;
+
+    __atomic_add_fetch(&entries[id].excl, elapsed - f->child, __ATOMIC_RELAXED);
+
+    if (--active[id] == 0)
+    {
+        __atomic_add_fetch(&entries[id].incl, elapsed, __ATOMIC_RELAXED);
+    }
+
+    if (depth > 0)
+    {
+        stack[depth - 1].child += elapsed;
+    }
+}
+
+// ---------- Report ----------
+
+// Order by exclusive time, most first.
+static int by_excl(const void *x, const void *y)
+{
+    const prof_entry *a = *(prof_entry **)x;
+    const prof_entry *b = *(prof_entry **)y;
+
+    return (a->excl < b->excl) - (a->excl > b->excl);
+}
+
+// Return the called entries, sorted. Result must be freed.
+static prof_entry **sorted(int *count)
+{
+    prof_entry **list = malloc(sizeof(prof_entry *) * PROF_MAX);
+    *count = 0;
+
+    for (int i = 0; i < PROF_MAX; i++)
+    {
+        if (entries[i].calls)
+        {
+            list[(*count)++] = &entries[i];
+        }
+    }
+
+    qsort(list, *count, sizeof(prof_entry *), by_excl);
+
+    return list;
+}
+
+void prof_print_table(FILE *f)
+{
+    int count;
+    prof_entry **list = sorted(&count);
+
+    fprintf(f, "---------- Profile ----------\n");
+    fprintf(f, "%12s %14s %14s  %s\n", "Calls", "Inclusive ms", "Exclusive ms", "Function");
+
+    for (int i = 0; i < count; i++)
+    {
+        fprintf(f, "%12ld %14.3f %14.3f  %s%s\n", list[i]->calls, list[i]->incl / 1e6, list[i]->excl / 1e6,
+            list[i]->name, list[i]->builtin ? " (builtin)" : "");
+    }
+
+    free(list);
+}
+
+static void print_json_str(FILE *f, char *s)
+{
+    fputc('"', f);
+
+    for (; *s; s++)
+    {
+        if (*s == '"' || *s == '\\')
+        {
+            fprintf(f, "\\%c", *s);
+        }
+        else if ((unsigned char)*s < 0x20)
+        {
+            fprintf(f, "\\u%04x", *s);
+        }
+        else
+        {
+            fputc(*s, f);
+        }
+    }
+
+    fputc('"', f);
+}
+
+// Times are in nanoseconds.
+void prof_print_json(FILE *f)
+{
+    int count;
+    prof_entry **list = sorted(&count);
+
+    fputc('[', f);
+
+    for (int i = 0; i < count; i++)
+    {
+        fprintf(f, "%s\n  {\"name\": ", i ? "," : "");
+        print_json_str(f, list[i]->name);
+        fprintf(f, ", \"builtin\": %s, \"calls\": %ld, \"inclusive_ns\": %ld, \"exclusive_ns\": %ld}",
+            list[i]->builtin ? "true" : "false", list[i]->calls, list[i]->incl, list[i]->excl);
+    }
+
+    fprintf(f, "\n]\n");
+
+    free(list);
+}
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef PROF_H
+#define PROF_H
+
+// Per-function call counts and timing. Only compiled with ZLISP_PROFILE ('make profile'),
+// so other builds have no instrumentation in 'call'.
+#ifdef ZLISP_PROFILE
+
+#include <stdio.h>
+
+#include "types.h"
+
+// Maximum number of profiled functions. Later functions are counted as "<other>".
+#define PROF_MAX 16384
+
+// Set by '--profile'. Calls are only timed while enabled.
+extern int prof_enabled;
+
+// ---------- Functions ----------
+
+int prof_intern(char *name, int builtin);
+
+void prof_label_fun(val *f, char *name);
+
+void prof_name_fun(val *f);
+
+// ---------- Timing ----------
+
+void prof_enter(int id);
+
+void prof_leave(int id);
+
+// ---------- Report ----------
+
+void prof_print_table(FILE *f);
+
+void prof_print_json(FILE *f);
+
+#else
+
+// Never enabled in other builds.
+#define prof_enabled 0
+
+#endif
+
+#endif
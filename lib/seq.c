@@ -0,0 +1,536 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "builtin.h"
+#include "types.h"
+#include "interp.h"
+#include "seq.h"
+#include "file.h"
+
+// Consumer state of one node of a Sequence.
+typedef struct iter
+{
+    seq *s;
+
+    // Range: next value. List: next index. Take, Drop: number of elements taken or dropped.
+    long pos;
+
+    // Lines of a path: the file, opened for this iteration.
+    handle *file;
+
+    struct iter *src;
+} iter;
+
+// ---------- Create, Free ----------
+
+// Create a node on top of a source node. Takes ownership of the source reference.
+seq *seq_new(seq_t kind, seq *src)
+{
+    seq *s = malloc(sizeof(seq));
+    *s = (seq){.refs = 1, .kind = kind, .src = src, .f = NULL, .list = NULL, .start = 0, .end = 0, .step = 1, .n = 0, .path = NULL, .file = NULL};
+    return s;
+}
+
+// Release a reference. Nodes are freed with their last reference, then release their source.
+void seq_free(seq *s)
+{
+    while (s && __atomic_sub_fetch(&s->refs, 1, __ATOMIC_ACQ_REL) == 0)
+    {
+        seq *src = s->src;
+
+        if (s->f)
+        {
+            free_val(s->f);
+        }
+        if (s->list)
+        {
+            free_val(s->list);
+        }
+        if (s->file)
+        {
+            handle_free(s->file);
+        }
+        free(s->path);
+        free(s);
+
+        s = src;
+    }
+}
+
+// Add a reference. Copying a Sequence value is O(1).
+seq *seq_share(seq *s)
+{
+    __atomic_add_fetch(&s->refs, 1, __ATOMIC_RELAXED);
+    return s;
+}
+
+// ---------- Iteration ----------
+
+static iter *iter_new(seq *s)
+{
+    iter *it = malloc(sizeof(iter));
+    it->s = s;
+    it->pos = s->kind == S_RANGE ? s->start : 0;
+    it->src = s->src ? iter_new(s->src) : NULL;
+    it->file = s->kind == S_LINES && s->path ? handle_open(s->path, "r") : NULL;
+    return it;
+}
+
+static void iter_free(iter *it)
+{
+    while (it)
+    {
+        iter *src = it->src;
+        if (it->file)
+        {
+            handle_free(it->file);
+        }
+        free(it);
+        it = src;
+    }
+}
+
+// Call a Function of a node with arguments.
+static val *seq_apply(env *e, val *f, val *args)
+{
+    val *fc = copy_val(f);
+    val *r = call(e, fc, args);
+    free_val(fc);
+    return r;
+}
+
+// Pull the next element. Returns 1 and sets 'out', 0 if there are no more elements,
+// or -1 and sets 'out' to an Error.
+static int iter_next(iter *it, env *e, val **out)
+{
+    seq *s = it->s;
+
+    switch (s->kind)
+    {
+    case S_RANGE:
+        if (s->step > 0 ? it->pos >= s->end : it->pos <= s->end)
+        {
+            return 0;
+        }
+
+        *out = new_int(it->pos);
+        it->pos += s->step;
+        return 1;
+
+    case S_LIST:
+        if (it->pos >= s->list->d.exp.count)
+        {
+            return 0;
+        }
+
+        *out = copy_val(s->list->d.exp.list[it->pos++]);
+        return 1;
+
+    case S_MAP:
+    {
+        int r = iter_next(it->src, e, out);
+        if (r != 1)
+        {
+            return r;
+        }
+
+        *out = seq_apply(e, s->f, exp_add(new_exp(), *out));
+        return (*out)->type == T_ERR ? -1 : 1;
+    }
+
+    case S_FILTER:
+        for (;;)
+        {
+            int r = iter_next(it->src, e, out);
+            if (r != 1)
+            {
+                return r;
+            }
+
+            val *keep = seq_apply(e, s->f, exp_add(new_exp(), copy_val(*out)));
+
+            if (keep->type != T_INT)
+            {
+                free_val(*out);
+                *out = keep->type == T_ERR
+                    ? copy_val(keep)
+                    : new_err("Function 'seq-filter' passed a Function which returned %s. Expected Integer.", type_name(keep->type));
+                free_val(keep);
+                return -1;
+            }
+
+            int k = keep->d.intg != 0;
+            free_val(keep);
+
+            if (k)
+            {
+                return 1;
+            }
+
+            free_val(*out);
+        }
+
+    case S_TAKE:
+        if (it->pos >= s->n)
+        {
+            return 0;
+        }
+
+        it->pos++;
+        return iter_next(it->src, e, out);
+
+    case S_DROP:
+        while (it->pos < s->n)
+        {
+            int r = iter_next(it->src, e, out);
+            if (r != 1)
+            {
+                return r;
+            }
+
+            free_val(*out);
+            it->pos++;
+        }
+
+        return iter_next(it->src, e, out);
+
+    case S_LINES:
+    {
+        handle *h = s->file ? s->file : it->file;
+
+        if (h == NULL)
+        {
+            *out = new_err("Function 'lines' unable to open file '%s'.", s->path);
+            return -1;
+        }
+
+        char *line = handle_read_line(h);
+
+        if (line == NULL)
+        {
+            return 0;
+        }
+
+        *out = new_str(line);
+        return 1;
+    }
+    }
+
+    return 0;
+}
+
+// ---------- Consume ----------
+
+// Materialize into a List, or return the first Error.
+val *seq_to_list(seq *s, env *e)
+{
+    iter *it = iter_new(s);
+    val *l = new_lst();
+    val *x;
+    int r;
+
+    while ((r = iter_next(it, e, &x)) == 1)
+    {
+        exp_add(l, x);
+    }
+
+    iter_free(it);
+
+    if (r == -1)
+    {
+        free_val(l);
+        return x;
+    }
+
+    return l;
+}
+
+// Number of elements. Ranges are counted without iterating.
+val *seq_len(seq *s, env *e)
+{
+    if (s->kind == S_RANGE)
+    {
+        long n = s->step > 0 ? (s->end - s->start + s->step - 1) / s->step : (s->start - s->end - s->step - 1) / -s->step;
+        return new_int(n > 0 ? n : 0);
+    }
+
+    iter *it = iter_new(s);
+    long n = 0;
+    val *x;
+    int r;
+
+    while ((r = iter_next(it, e, &x)) == 1)
+    {
+        free_val(x);
+        n++;
+    }
+
+    iter_free(it);
+
+    return r == -1 ? x : new_int(n);
+}
+
+// Element i, or NULL if out of bounds.
+val *seq_get(seq *s, env *e, long i)
+{
+    iter *it = iter_new(s);
+    val *x = NULL;
+    int r;
+
+    while ((r = iter_next(it, e, &x)) == 1 && i > 0)
+    {
+        free_val(x);
+        i--;
+    }
+
+    iter_free(it);
+
+    return r == 0 ? NULL : x;
+}
+
+// ---------- Print ----------
+
+static int has_seq(val *x)
+{
+    if (x->type == T_SEQ)
+    {
+        return 1;
+    }
+
+    if (x->type == T_LST)
+    {
+        for (int i = 0; i < x->d.exp.count; i++)
+        {
+            if (has_seq(x->d.exp.list[i]))
+            {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+// Replace a Sequence, and Sequences within a List, by the List of its elements, evaluated in e. Builtins which print
+// their arguments use this first, so Functions of the Sequence see the locals of the caller. Returns the Error, and
+// frees x, if evaluating an element fails.
+val *seq_force(val *x, env *e)
+{
+    if (!has_seq(x))
+    {
+        return x;
+    }
+
+    if (x->type == T_SEQ)
+    {
+        val *l = seq_to_list(x->d.seq, e);
+        free_val(x);
+
+        return l->type == T_ERR ? l : seq_force(l, e);
+    }
+
+    exp_own(x);
+    for (int i = 0; i < x->d.exp.count; i++)
+    {
+        x->d.exp.list[i] = seq_force(x->d.exp.list[i], e);
+
+        if (x->d.exp.list[i]->type == T_ERR)
+        {
+            return exp_take(x, i);
+        }
+    }
+
+    return x;
+}
+
+// Printed as its elements, evaluated in the global environment of the running interpreter.
+char *seq_to_str(seq *s)
+{
+    if (current_interp == NULL)
+    {
+        char *str = malloc(strlen("<sequence>") + 1);
+        strcpy(str, "<sequence>");
+        return str;
+    }
+
+    val *l = seq_to_list(s, current_interp->env);
+    char *str = val_to_str(l);
+    free_val(l);
+
+    return str;
+}
+
+// ---------- Builtins ----------
+
+// Return the Sequence of argument i, or a Sequence over it if it is a List. Returns NULL otherwise.
+static seq *seq_arg(val *v, int i)
+{
+    val *x = v->d.exp.list[i];
+
+    if (x->type == T_SEQ)
+    {
+        return seq_share(x->d.seq);
+    }
+
+    if (x->type == T_LST)
+    {
+        seq *s = seq_new(S_LIST, NULL);
+        s->list = x;
+        v->d.exp.list[i] = new_lst();
+        return s;
+    }
+
+    return NULL;
+}
+
+// Assert argument i is a Sequence or a List, and take it as a Sequence.
+#define SEQ_ARG(func, args, index, s)                                                                          \
+    seq *s = seq_arg(args, index);                                                                             \
+    ASSERT(args, s, "Function '%s' passed incorrect type for argument %i. Got %s, Expected Sequence or List.", \
+        func, index, type_name(args->d.exp.list[index]->type));
+
+// Create a Sequence of Integers from start (default 0) to end (excluded), by step (default 1).
+// Accepts end, start and end, or start, end and step.
+val *b_range(env *e, val *v)
+{
+    ASSERT(v, v->d.exp.count >= 1 && v->d.exp.count <= 3,
+        "Function 'range' passed incorrect number of arguments. Got %i, Expected 1 to 3.", v->d.exp.count);
+
+    for (int i = 0; i < v->d.exp.count; i++)
+    {
+        ASSERT_TYPE("range", v, i, T_INT);
+    }
+
+    seq *s = seq_new(S_RANGE, NULL);
+
+    if (v->d.exp.count == 1)
+    {
+        s->end = v->d.exp.list[0]->d.intg;
+    }
+    else
+    {
+        s->start = v->d.exp.list[0]->d.intg;
+        s->end = v->d.exp.list[1]->d.intg;
+    }
+
+    if (v->d.exp.count == 3)
+    {
+        s->step = v->d.exp.list[2]->d.intg;
+    }
+
+    if (s->step == 0)
+    {
+        seq_free(s);
+        free_val(v);
+        return new_err("Function 'range' passed step 0.");
+    }
+
+    free_val(v);
+
+    return new_seq(s);
+}
+
+// Shared by seq-map and seq-filter. Accepts a Function, and a Sequence or a List.
+static val *seq_fun(val *v, seq_t kind, char *func)
+{
+    ASSERT_NUM(func, v, 2);
+    ASSERT_TYPE(func, v, 0, T_FUN);
+    SEQ_ARG(func, v, 1, src);
+
+    seq *s = seq_new(kind, src);
+    s->f = exp_pop(v, 0);
+
+    free_val(v);
+
+    return new_seq(s);
+}
+
+// Lazily apply a Function to each element.
+val *b_seq_map(env *e, val *v)
+{
+    return seq_fun(v, S_MAP, "seq-map");
+}
+
+// Lazily keep the elements for which a Function returns true.
+val *b_seq_filter(env *e, val *v)
+{
+    return seq_fun(v, S_FILTER, "seq-filter");
+}
+
+// Shared by seq-take and seq-drop. Accepts an Integer, and a Sequence or a List.
+static val *seq_count(val *v, seq_t kind, char *func)
+{
+    ASSERT_NUM(func, v, 2);
+    ASSERT_TYPE(func, v, 0, T_INT);
+    SEQ_ARG(func, v, 1, src);
+
+    seq *s = seq_new(kind, src);
+    s->n = v->d.exp.list[0]->d.intg;
+
+    free_val(v);
+
+    return new_seq(s);
+}
+
+// Lazily take the first N elements.
+val *b_seq_take(env *e, val *v)
+{
+    return seq_count(v, S_TAKE, "seq-take");
+}
+
+// Lazily drop the first N elements.
+val *b_seq_drop(env *e, val *v)
+{
+    return seq_count(v, S_DROP, "seq-drop");
+}
+
+// Fold a Sequence from the left, one element at a time. Accepts a Function, an initial value, and a Sequence or a List.
+val *b_seq_foldl(env *e, val *v)
+{
+    ASSERT_NUM("seq-foldl", v, 3);
+    ASSERT_TYPE("seq-foldl", v, 0, T_FUN);
+    SEQ_ARG("seq-foldl", v, 2, s);
+
+    val *f = v->d.exp.list[0];
+    val *acc = exp_pop(v, 1);
+
+    iter *it = iter_new(s);
+    val *x;
+    int r;
+
+    while ((r = iter_next(it, e, &x)) == 1)
+    {
+        acc = seq_apply(e, f, exp_add(exp_add(new_exp(), acc), x));
+
+        if (acc->type == T_ERR)
+        {
+            break;
+        }
+    }
+
+    if (r == -1)
+    {
+        free_val(acc);
+        acc = x;
+    }
+
+    iter_free(it);
+    seq_free(s);
+    free_val(v);
+
+    return acc;
+}
+
+// Materialize a Sequence into a List.
+val *b_seq_list(env *e, val *v)
+{
+    ASSERT_NUM("seq-list", v, 1);
+    SEQ_ARG("seq-list", v, 0, s);
+
+    val *l = seq_to_list(s, e);
+
+    seq_free(s);
+    free_val(v);
+
+    return l;
+}
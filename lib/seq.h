@@ -0,0 +1,74 @@
+#ifndef SEQ_H
+#define SEQ_H
+
+#include "types.h"
+
+typedef enum
+{
+    S_RANGE,  // Integers from 'start' to 'end' (excluded) by 'step'
+    S_LIST,   // Elements of 'list'
+    S_MAP,    // 'f' applied to each element of 'src'
+    S_FILTER, // Elements of 'src' for which 'f' returns true
+    S_TAKE,   // First 'n' elements of 'src'
+    S_DROP,   // Elements of 'src' after the first 'n'
+    S_LINES   // Lines of the file at 'path', or of the open 'file'
+} seq_t;
+
+// Lazy Sequence. Combinators are nodes on top of their source, and nothing is computed until
+// the Sequence is consumed, pulling one element at a time through the whole chain.
+// Nodes are never changed after creation, so copies of a Sequence value share them.
+struct seq
+{
+    int refs;
+
+    seq_t kind;
+    seq *src;
+
+    val *f;
+    val *list;
+    long start, end, step;
+    long n;
+
+    char *path;
+    handle *file;
+};
+
+// ---------- Create, Free ----------
+
+seq *seq_new(seq_t kind, seq *src);
+
+void seq_free(seq *s);
+
+seq *seq_share(seq *s);
+
+// ---------- Consume ----------
+
+val *seq_to_list(seq *s, env *e);
+
+val *seq_len(seq *s, env *e);
+
+val *seq_get(seq *s, env *e, long i);
+
+// ---------- Print ----------
+
+val *seq_force(val *x, env *e);
+
+char *seq_to_str(seq *s);
+
+// ---------- Builtins ----------
+
+val *b_range(env *e, val *v);
+
+val *b_seq_map(env *e, val *v);
+
+val *b_seq_filter(env *e, val *v);
+
+val *b_seq_take(env *e, val *v);
+
+val *b_seq_drop(env *e, val *v);
+
+val *b_seq_foldl(env *e, val *v);
+
+val *b_seq_list(env *e, val *v);
+
+#endif
@@ -0,0 +1,634 @@
+#include <stdlib.h>
+
+#include "simd.h"
+
+// Vector kernels are compiled for AVX/AVX2 with target attributes, and selected at runtime,
+// so the default build runs on any x86-64 processor. SSE2 is always available on x86-64.
+#if defined(__GNUC__) && defined(__x86_64__) && __SIZEOF_LONG__ == 8
+#include <immintrin.h>
+#define SIMD_X86
+#define TARGET_AVX __attribute__((target("avx")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define HAS_AVX __builtin_cpu_supports("avx")
+#define HAS_AVX2 __builtin_cpu_supports("avx2")
+
+#define LOAD_SI128(p) _mm_loadu_si128((const __m128i *)(p))
+#define STORE_SI128(p, a) _mm_storeu_si128((__m128i *)(p), a)
+#define LOAD_SI256(p) _mm256_loadu_si256((const __m256i *)(p))
+#define STORE_SI256(p, a) _mm256_storeu_si256((__m256i *)(p), a)
+#endif
+
+// Apply FN to W elements at a time, while at least W are left. 'i' is left at the first unprocessed element.
+#define VEC_LOOP(W, LOAD, STORE, FN)                                \
+    for (; i + W <= n; i += W)                                      \
+    {                                                               \
+        STORE(r + i, FN(LOAD(x + i), y ? LOAD(y + i) : vs));        \
+    }
+
+// Scalar loop for operator OPR, with 'y' or the scalar 's'.
+#define SCALAR_LOOP(OPR)                                            \
+    if (y)                                                          \
+    {                                                               \
+        for (int i = 0; i < n; i++)                                 \
+        {                                                           \
+            r[i] = x[i] OPR y[i];                                   \
+        }                                                           \
+    }                                                               \
+    else                                                            \
+    {                                                               \
+        for (int i = 0; i < n; i++)                                 \
+        {                                                           \
+            r[i] = x[i] OPR s;                                      \
+        }                                                           \
+    }
+
+// ---------- Float - Scalar ----------
+
+static void f64_op_scalar(simd_op op, double *r, const double *x, const double *y, double s, int n)
+{
+    switch (op)
+    {
+    case OP_ADD:
+        SCALAR_LOOP(+);
+        break;
+    case OP_SUB:
+        SCALAR_LOOP(-);
+        break;
+    case OP_MUL:
+        SCALAR_LOOP(*);
+        break;
+    case OP_DIV:
+        SCALAR_LOOP(/);
+        break;
+    }
+}
+
+static void f64_cmp_scalar(simd_cmp cmp, long *r, const double *x, const double *y, double s, int n)
+{
+    switch (cmp)
+    {
+    case CMP_LT:
+        SCALAR_LOOP(<);
+        break;
+    case CMP_LE:
+        SCALAR_LOOP(<=);
+        break;
+    case CMP_GT:
+        SCALAR_LOOP(>);
+        break;
+    case CMP_GE:
+        SCALAR_LOOP(>=);
+        break;
+    case CMP_EQ:
+        SCALAR_LOOP(==);
+        break;
+    case CMP_NE:
+        SCALAR_LOOP(!=);
+        break;
+    }
+}
+
+#ifdef SIMD_X86
+
+// ---------- Float - AVX ----------
+
+TARGET_AVX static int f64_op_avx(simd_op op, double *r, const double *x, const double *y, double s, int n)
+{
+    __m256d vs = _mm256_set1_pd(s);
+    int i = 0;
+
+    switch (op)
+    {
+    case OP_ADD:
+        VEC_LOOP(4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_add_pd);
+        break;
+    case OP_SUB:
+        VEC_LOOP(4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_sub_pd);
+        break;
+    case OP_MUL:
+        VEC_LOOP(4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_mul_pd);
+        break;
+    case OP_DIV:
+        VEC_LOOP(4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_div_pd);
+        break;
+    }
+
+    return i;
+}
+
+TARGET_AVX static double f64_sum_avx(const double *x, const double *y, int n, int *done)
+{
+    __m256d acc = _mm256_setzero_pd();
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d a = _mm256_loadu_pd(x + i);
+        acc = _mm256_add_pd(acc, y ? _mm256_mul_pd(a, _mm256_loadu_pd(y + i)) : a);
+    }
+
+    double lanes[4];
+    _mm256_storeu_pd(lanes, acc);
+    *done = i;
+
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+TARGET_AVX static double f64_minmax_avx(const double *x, int n, int max, int *done)
+{
+    __m256d acc = _mm256_loadu_pd(x);
+    int i = 4;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d a = _mm256_loadu_pd(x + i);
+        acc = max ? _mm256_max_pd(acc, a) : _mm256_min_pd(acc, a);
+    }
+
+    double lanes[4];
+    _mm256_storeu_pd(lanes, acc);
+    *done = i;
+
+    double m = lanes[0];
+    for (int j = 1; j < 4; j++)
+    {
+        m = (max ? lanes[j] > m : lanes[j] < m) ? lanes[j] : m;
+    }
+
+    return m;
+}
+
+TARGET_AVX static int f64_cmp_avx(simd_cmp cmp, long *r, const double *x, const double *y, double s, int n)
+{
+    __m256d vs = _mm256_set1_pd(s);
+    __m256d one = _mm256_castsi256_pd(_mm256_set1_epi64x(1));
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d a = _mm256_loadu_pd(x + i);
+        __m256d b = y ? _mm256_loadu_pd(y + i) : vs;
+        __m256d m;
+
+        switch (cmp)
+        {
+        case CMP_LT:
+            m = _mm256_cmp_pd(a, b, _CMP_LT_OQ);
+            break;
+        case CMP_LE:
+            m = _mm256_cmp_pd(a, b, _CMP_LE_OQ);
+            break;
+        case CMP_GT:
+            m = _mm256_cmp_pd(a, b, _CMP_GT_OQ);
+            break;
+        case CMP_GE:
+            m = _mm256_cmp_pd(a, b, _CMP_GE_OQ);
+            break;
+        case CMP_EQ:
+            m = _mm256_cmp_pd(a, b, _CMP_EQ_OQ);
+            break;
+        default:
+            m = _mm256_cmp_pd(a, b, _CMP_NEQ_UQ);
+            break;
+        }
+
+        // All-ones lanes become 1.
+        _mm256_storeu_pd((double *)(r + i), _mm256_and_pd(m, one));
+    }
+
+    return i;
+}
+
+// ---------- Float - SSE2 ----------
+
+static int f64_op_sse2(simd_op op, double *r, const double *x, const double *y, double s, int n)
+{
+    __m128d vs = _mm_set1_pd(s);
+    int i = 0;
+
+    switch (op)
+    {
+    case OP_ADD:
+        VEC_LOOP(2, _mm_loadu_pd, _mm_storeu_pd, _mm_add_pd);
+        break;
+    case OP_SUB:
+        VEC_LOOP(2, _mm_loadu_pd, _mm_storeu_pd, _mm_sub_pd);
+        break;
+    case OP_MUL:
+        VEC_LOOP(2, _mm_loadu_pd, _mm_storeu_pd, _mm_mul_pd);
+        break;
+    case OP_DIV:
+        VEC_LOOP(2, _mm_loadu_pd, _mm_storeu_pd, _mm_div_pd);
+        break;
+    }
+
+    return i;
+}
+
+static double f64_sum_sse2(const double *x, const double *y, int n, int *done)
+{
+    __m128d acc = _mm_setzero_pd();
+    int i = 0;
+
+    for (; i + 2 <= n; i += 2)
+    {
+        __m128d a = _mm_loadu_pd(x + i);
+        acc = _mm_add_pd(acc, y ? _mm_mul_pd(a, _mm_loadu_pd(y + i)) : a);
+    }
+
+    double lanes[2];
+    _mm_storeu_pd(lanes, acc);
+    *done = i;
+
+    return lanes[0] + lanes[1];
+}
+
+#endif
+
+// ---------- Float ----------
+
+void f64_op(simd_op op, double *r, const double *x, const double *y, double s, int n)
+{
+    int i = 0;
+
+#ifdef SIMD_X86
+    i = HAS_AVX ? f64_op_avx(op, r, x, y, s, n) : f64_op_sse2(op, r, x, y, s, n);
+#endif
+
+    f64_op_scalar(op, r + i, x + i, y ? y + i : NULL, s, n - i);
+}
+
+// Sum of x, or of x * y if y is not NULL. The order of additions differs from a left fold,
+// so the result may differ in the last bits.
+static double f64_sum_prod(const double *x, const double *y, int n)
+{
+    double sum = 0;
+    int i = 0;
+
+#ifdef SIMD_X86
+    sum = HAS_AVX ? f64_sum_avx(x, y, n, &i) : f64_sum_sse2(x, y, n, &i);
+#endif
+
+    for (; i < n; i++)
+    {
+        sum += y ? x[i] * y[i] : x[i];
+    }
+
+    return sum;
+}
+
+double f64_sum(const double *x, int n)
+{
+    return f64_sum_prod(x, NULL, n);
+}
+
+double f64_dot(const double *x, const double *y, int n)
+{
+    return f64_sum_prod(x, y, n);
+}
+
+// Minimum or maximum of a non-empty array.
+static double f64_minmax(const double *x, int n, int max)
+{
+    double m = x[0];
+    int i = 1;
+
+#ifdef SIMD_X86
+    if (n >= 8 && HAS_AVX)
+    {
+        m = f64_minmax_avx(x, n, max, &i);
+    }
+#endif
+
+    for (; i < n; i++)
+    {
+        m = (max ? x[i] > m : x[i] < m) ? x[i] : m;
+    }
+
+    return m;
+}
+
+double f64_min(const double *x, int n)
+{
+    return f64_minmax(x, n, 0);
+}
+
+double f64_max(const double *x, int n)
+{
+    return f64_minmax(x, n, 1);
+}
+
+void f64_cmp(simd_cmp cmp, long *r, const double *x, const double *y, double s, int n)
+{
+    int i = 0;
+
+#ifdef SIMD_X86
+    if (HAS_AVX)
+    {
+        i = f64_cmp_avx(cmp, r, x, y, s, n);
+    }
+#endif
+
+    f64_cmp_scalar(cmp, r + i, x + i, y ? y + i : NULL, s, n - i);
+}
+
+// ---------- Integer - Scalar ----------
+
+// LONG_MIN / -1 overflows, and traps on most machines, so it wraps like '/' on Integers.
+static inline long i64_div(long x, long y)
+{
+    return y == -1 ? (long)(0UL - (unsigned long)x) : x / y;
+}
+
+static void i64_op_scalar(simd_op op, long *r, const long *x, const long *y, long s, int n)
+{
+    switch (op)
+    {
+    case OP_ADD:
+        SCALAR_LOOP(+);
+        break;
+    case OP_SUB:
+        SCALAR_LOOP(-);
+        break;
+    case OP_MUL:
+        SCALAR_LOOP(*);
+        break;
+    case OP_DIV:
+        for (int i = 0; i < n; i++)
+        {
+            r[i] = i64_div(x[i], y ? y[i] : s);
+        }
+        break;
+    }
+}
+
+static void i64_cmp_scalar(simd_cmp cmp, long *r, const long *x, const long *y, long s, int n)
+{
+    switch (cmp)
+    {
+    case CMP_LT:
+        SCALAR_LOOP(<);
+        break;
+    case CMP_LE:
+        SCALAR_LOOP(<=);
+        break;
+    case CMP_GT:
+        SCALAR_LOOP(>);
+        break;
+    case CMP_GE:
+        SCALAR_LOOP(>=);
+        break;
+    case CMP_EQ:
+        SCALAR_LOOP(==);
+        break;
+    case CMP_NE:
+        SCALAR_LOOP(!=);
+        break;
+    }
+}
+
+#ifdef SIMD_X86
+
+// ---------- Integer - AVX2 ----------
+
+// Only addition and subtraction have 64-bit vector instructions before AVX-512.
+TARGET_AVX2 static int i64_op_avx2(simd_op op, long *r, const long *x, const long *y, long s, int n)
+{
+    __m256i vs = _mm256_set1_epi64x(s);
+    int i = 0;
+
+    if (op == OP_ADD)
+    {
+        VEC_LOOP(4, LOAD_SI256, STORE_SI256, _mm256_add_epi64);
+    }
+    else if (op == OP_SUB)
+    {
+        VEC_LOOP(4, LOAD_SI256, STORE_SI256, _mm256_sub_epi64);
+    }
+
+    return i;
+}
+
+TARGET_AVX2 static long i64_sum_avx2(const long *x, int n, int *done)
+{
+    __m256i acc = _mm256_setzero_si256();
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        acc = _mm256_add_epi64(acc, LOAD_SI256(x + i));
+    }
+
+    long lanes[4];
+    STORE_SI256(lanes, acc);
+    *done = i;
+
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+TARGET_AVX2 static long i64_minmax_avx2(const long *x, int n, int max, int *done)
+{
+    __m256i acc = LOAD_SI256(x);
+    int i = 4;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256i a = LOAD_SI256(x + i);
+        __m256i gt = _mm256_cmpgt_epi64(acc, a);
+
+        // Take 'a' where it is smaller (min) or not smaller (max).
+        acc = max ? _mm256_blendv_epi8(a, acc, gt) : _mm256_blendv_epi8(acc, a, gt);
+    }
+
+    long lanes[4];
+    STORE_SI256(lanes, acc);
+    *done = i;
+
+    long m = lanes[0];
+    for (int j = 1; j < 4; j++)
+    {
+        m = (max ? lanes[j] > m : lanes[j] < m) ? lanes[j] : m;
+    }
+
+    return m;
+}
+
+TARGET_AVX2 static int i64_cmp_avx2(simd_cmp cmp, long *r, const long *x, const long *y, long s, int n)
+{
+    __m256i vs = _mm256_set1_epi64x(s);
+    __m256i one = _mm256_set1_epi64x(1);
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256i a = LOAD_SI256(x + i);
+        __m256i b = y ? LOAD_SI256(y + i) : vs;
+        __m256i m;
+
+        // Only '>' and '==' exist. The others are their swaps or negations.
+        switch (cmp)
+        {
+        case CMP_LT:
+            m = _mm256_and_si256(_mm256_cmpgt_epi64(b, a), one);
+            break;
+        case CMP_LE:
+            m = _mm256_andnot_si256(_mm256_cmpgt_epi64(a, b), one);
+            break;
+        case CMP_GT:
+            m = _mm256_and_si256(_mm256_cmpgt_epi64(a, b), one);
+            break;
+        case CMP_GE:
+            m = _mm256_andnot_si256(_mm256_cmpgt_epi64(b, a), one);
+            break;
+        case CMP_EQ:
+            m = _mm256_and_si256(_mm256_cmpeq_epi64(a, b), one);
+            break;
+        default:
+            m = _mm256_andnot_si256(_mm256_cmpeq_epi64(a, b), one);
+            break;
+        }
+
+        STORE_SI256(r + i, m);
+    }
+
+    return i;
+}
+
+// ---------- Integer - SSE2 ----------
+
+static int i64_op_sse2(simd_op op, long *r, const long *x, const long *y, long s, int n)
+{
+    __m128i vs = _mm_set1_epi64x(s);
+    int i = 0;
+
+    if (op == OP_ADD)
+    {
+        VEC_LOOP(2, LOAD_SI128, STORE_SI128, _mm_add_epi64);
+    }
+    else if (op == OP_SUB)
+    {
+        VEC_LOOP(2, LOAD_SI128, STORE_SI128, _mm_sub_epi64);
+    }
+
+    return i;
+}
+
+static long i64_sum_sse2(const long *x, int n, int *done)
+{
+    __m128i acc = _mm_setzero_si128();
+    int i = 0;
+
+    for (; i + 2 <= n; i += 2)
+    {
+        acc = _mm_add_epi64(acc, LOAD_SI128(x + i));
+    }
+
+    long lanes[2];
+    STORE_SI128(lanes, acc);
+    *done = i;
+
+    return lanes[0] + lanes[1];
+}
+
+#endif
+
+// ---------- Integer ----------
+
+// Returns 0 on division by zero, leaving r incomplete.
+int i64_op(simd_op op, long *r, const long *x, const long *y, long s, int n)
+{
+    if (op == OP_DIV)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            if ((y ? y[i] : s) == 0)
+            {
+                return 0;
+            }
+        }
+    }
+
+    int i = 0;
+
+#ifdef SIMD_X86
+    i = HAS_AVX2 ? i64_op_avx2(op, r, x, y, s, n) : i64_op_sse2(op, r, x, y, s, n);
+#endif
+
+    i64_op_scalar(op, r + i, x + i, y ? y + i : NULL, s, n - i);
+
+    return 1;
+}
+
+long i64_sum(const long *x, int n)
+{
+    long sum = 0;
+    int i = 0;
+
+#ifdef SIMD_X86
+    sum = HAS_AVX2 ? i64_sum_avx2(x, n, &i) : i64_sum_sse2(x, n, &i);
+#endif
+
+    for (; i < n; i++)
+    {
+        sum += x[i];
+    }
+
+    return sum;
+}
+
+long i64_dot(const long *x, const long *y, int n)
+{
+    long sum = 0;
+
+    for (int i = 0; i < n; i++)
+    {
+        sum += x[i] * y[i];
+    }
+
+    return sum;
+}
+
+// Minimum or maximum of a non-empty array.
+static long i64_minmax(const long *x, int n, int max)
+{
+    long m = x[0];
+    int i = 1;
+
+#ifdef SIMD_X86
+    if (n >= 8 && HAS_AVX2)
+    {
+        m = i64_minmax_avx2(x, n, max, &i);
+    }
+#endif
+
+    for (; i < n; i++)
+    {
+        m = (max ? x[i] > m : x[i] < m) ? x[i] : m;
+    }
+
+    return m;
+}
+
+long i64_min(const long *x, int n)
+{
+    return i64_minmax(x, n, 0);
+}
+
+long i64_max(const long *x, int n)
+{
+    return i64_minmax(x, n, 1);
+}
+
+void i64_cmp(simd_cmp cmp, long *r, const long *x, const long *y, long s, int n)
+{
+    int i = 0;
+
+#ifdef SIMD_X86
+    if (HAS_AVX2)
+    {
+        i = i64_cmp_avx2(cmp, r, x, y, s, n);
+    }
+#endif
+
+    i64_cmp_scalar(cmp, r + i, x + i, y ? y + i : NULL, s, n - i);
+}
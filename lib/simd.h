@@ -0,0 +1,55 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// Element-wise operations.
+typedef enum
+{
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV
+} simd_op;
+
+// Comparisons, producing a mask of 0/1.
+typedef enum
+{
+    CMP_LT,
+    CMP_LE,
+    CMP_GT,
+    CMP_GE,
+    CMP_EQ,
+    CMP_NE
+} simd_cmp;
+
+// Kernels use AVX/AVX2 when the processor supports it, SSE2 on other x86-64 processors, and scalar loops elsewhere.
+// For binary operations, 'y' may be NULL, in which case the scalar 's' is used for every element.
+
+// ---------- Float ----------
+
+void f64_op(simd_op op, double *r, const double *x, const double *y, double s, int n);
+
+double f64_sum(const double *x, int n);
+
+double f64_dot(const double *x, const double *y, int n);
+
+double f64_min(const double *x, int n);
+
+double f64_max(const double *x, int n);
+
+void f64_cmp(simd_cmp cmp, long *r, const double *x, const double *y, double s, int n);
+
+// ---------- Integer ----------
+
+int i64_op(simd_op op, long *r, const long *x, const long *y, long s, int n);
+
+long i64_sum(const long *x, int n);
+
+long i64_dot(const long *x, const long *y, int n);
+
+long i64_min(const long *x, int n);
+
+long i64_max(const long *x, int n);
+
+void i64_cmp(simd_cmp cmp, long *r, const long *x, const long *y, long s, int n);
+
+#endif
@@ -0,0 +1,102 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+#include "interp.h"
+#include "site.h"
+
+// Bits of the filter of names bound outside global environments.
+#define SHADOW_BITS 4096
+
+#define WORD_BITS (8 * sizeof(unsigned long))
+
+// Names ever bound in a local or module environment, by hash. Scoping is dynamic, so such a name may hide the global
+// definition from any lookup, and is never answered from the cache. Bits are only set, shared by all threads.
+static unsigned long shadowed[SHADOW_BITS / WORD_BITS];
+
+// 64-bit FNV-1a.
+static unsigned long hash_name(char *name)
+{
+    unsigned long h = 14695981039346656037UL;
+
+    for (; *name; name++)
+    {
+        h = (h ^ (unsigned char)*name) * 1099511628211UL;
+    }
+
+    return h % SHADOW_BITS;
+}
+
+// ---------- Create, Free ----------
+
+site *site_new(char *name)
+{
+    site *s = malloc(sizeof(site) + strlen(name) + 1);
+
+    s->refs = 1;
+    s->env = NULL;
+    s->index = 0;
+    s->hash = hash_name(name);
+    strcpy(s->name, name);
+
+    STAT_ADD(bytes, sizeof(site) + strlen(name) + 1);
+
+    return s;
+}
+
+void site_free(site *s)
+{
+    if (__atomic_sub_fetch(&s->refs, 1, __ATOMIC_ACQ_REL) > 0)
+    {
+        return;
+    }
+
+    free(s);
+}
+
+// Add a reference. Copying a Symbol is O(1).
+site *site_share(site *s)
+{
+    __atomic_add_fetch(&s->refs, 1, __ATOMIC_RELAXED);
+    return s;
+}
+
+// ---------- Cache ----------
+
+// Mark a name as bound outside a global environment.
+void site_shadow(char *name)
+{
+    unsigned long h = hash_name(name);
+    unsigned long bit = 1UL << (h % WORD_BITS);
+
+    if (!(__atomic_load_n(&shadowed[h / WORD_BITS], __ATOMIC_RELAXED) & bit))
+    {
+        __atomic_fetch_or(&shadowed[h / WORD_BITS], bit, __ATOMIC_RELAXED);
+    }
+}
+
+// Return the cached definition of a name in a global environment, without copying it, or NULL if not cached.
+val *site_get(site *s, env *global)
+{
+    if (__atomic_load_n(&s->env, __ATOMIC_RELAXED) != global ||
+        __atomic_load_n(&shadowed[s->hash / WORD_BITS], __ATOMIC_RELAXED) & (1UL << (s->hash % WORD_BITS)))
+    {
+        return NULL;
+    }
+
+    int i = __atomic_load_n(&s->index, __ATOMIC_RELAXED);
+
+    if (i >= global->count || strcmp(global->keys[i], s->name) != 0)
+    {
+        return NULL;
+    }
+
+    return global->vals[i];
+}
+
+// Cache the slot a name was found in.
+void site_set(site *s, env *global, int index)
+{
+    __atomic_store_n(&s->index, index, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->env, global, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,37 @@
+#ifndef SITE_H
+#define SITE_H
+
+#include "types.h"
+
+// Name of a Symbol, shared by all its copies, so the Symbols of a Function body copied on each call keep what was
+// learned by earlier calls: the slot of the global environment that the name was last found in.
+struct site
+{
+    int refs;
+
+    // Global environment and index of the cached definition, or NULL. Written without locks, so a cached slot is
+    // only used after checking that it still holds the name. Definitions are never removed, so slots never move.
+    env *env;
+    int index;
+
+    unsigned long hash;
+    char name[];
+};
+
+// ---------- Create, Free ----------
+
+site *site_new(char *name);
+
+void site_free(site *s);
+
+site *site_share(site *s);
+
+// ---------- Cache ----------
+
+void site_shadow(char *name);
+
+val *site_get(site *s, env *global);
+
+void site_set(site *s, env *global, int index);
+
+#endif
@@ -0,0 +1,229 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "builtin.h"
+#include "types.h"
+#include "sort.h"
+
+// Runs of this many elements are sorted by insertion before merging.
+#define SORT_RUN 16
+
+// Sort state. Elements are compared natively with 'less', or by calling the comparator Function 'f'.
+typedef struct
+{
+    env *e;
+    val *f;
+    int (*less)(val *x, val *y);
+
+    // First error returned by the comparator. Once set, the sort finishes without calling it again.
+    val *err;
+} sorter;
+
+// ---------- Native Comparison ----------
+
+static int less_int(val *x, val *y)
+{
+    return x->d.intg < y->d.intg;
+}
+
+// Integers are only converted when compared with Floats, so large Integers keep their precision.
+static int less_num(val *x, val *y)
+{
+    if (x->type == T_INT && y->type == T_INT)
+    {
+        return x->d.intg < y->d.intg;
+    }
+
+    double a = x->type == T_INT ? x->d.intg : x->d.flt;
+    double b = y->type == T_INT ? y->d.intg : y->d.flt;
+
+    return a < b;
+}
+
+static int less_str(val *x, val *y)
+{
+    return strcmp(x->d.str, y->d.str) < 0;
+}
+
+// Return the native comparison for a List, or NULL if its elements are not all Numbers or all Strings.
+static int (*native_less(val *l))(val *, val *)
+{
+    int ints = 0, flts = 0, strs = 0;
+
+    for (int i = 0; i < l->d.exp.count; i++)
+    {
+        val_t t = l->d.exp.list[i]->type;
+
+        ints += t == T_INT;
+        flts += t == T_FLT;
+        strs += t == T_STR;
+    }
+
+    if (ints == l->d.exp.count)
+    {
+        return less_int;
+    }
+    if (ints + flts == l->d.exp.count)
+    {
+        return less_num;
+    }
+    if (strs == l->d.exp.count)
+    {
+        return less_str;
+    }
+
+    return NULL;
+}
+
+// ---------- Merge Sort ----------
+
+static int sort_less(sorter *s, val *x, val *y)
+{
+    if (s->less)
+    {
+        return s->less(x, y);
+    }
+
+    if (s->err)
+    {
+        return 0;
+    }
+
+    val *f = copy_val(s->f);
+    val *r = call(s->e, f, exp_add(exp_add(new_exp(), copy_val(x)), copy_val(y)));
+    free_val(f);
+
+    if (r->type == T_ERR)
+    {
+        s->err = r;
+        return 0;
+    }
+
+    if (r->type != T_INT)
+    {
+        s->err = new_err("Function 'sort' comparator returned %s. Expected Integer.", type_name(r->type));
+        free_val(r);
+        return 0;
+    }
+
+    int lt = r->d.intg != 0;
+    free_val(r);
+
+    return lt;
+}
+
+// Sort a short run in place.
+static void insertion_sort(sorter *s, val **a, int n)
+{
+    for (int i = 1; i < n; i++)
+    {
+        val *x = a[i];
+        int j = i;
+
+        while (j > 0 && sort_less(s, x, a[j - 1]))
+        {
+            a[j] = a[j - 1];
+            j--;
+        }
+
+        a[j] = x;
+    }
+}
+
+// Merge the sorted ranges a[0, mid) and a[mid, n). Equal elements keep their order (stable).
+static void merge(sorter *s, val **a, int mid, int n, val **tmp)
+{
+    // Already in order.
+    if (!sort_less(s, a[mid], a[mid - 1]))
+    {
+        return;
+    }
+
+    memcpy(tmp, a, sizeof(val *) * mid);
+
+    int i = 0, j = mid, k = 0;
+
+    while (i < mid && j < n)
+    {
+        a[k++] = sort_less(s, a[j], tmp[i]) ? a[j++] : tmp[i++];
+    }
+
+    while (i < mid)
+    {
+        a[k++] = tmp[i++];
+    }
+}
+
+// Bottom-up merge sort: sort short runs, then merge neighbouring runs of doubling width.
+static void merge_sort(sorter *s, val **a, int n)
+{
+    for (int lo = 0; lo < n; lo += SORT_RUN)
+    {
+        insertion_sort(s, a + lo, n - lo < SORT_RUN ? n - lo : SORT_RUN);
+    }
+
+    if (n <= SORT_RUN)
+    {
+        return;
+    }
+
+    val **tmp = malloc(sizeof(val *) * n);
+
+    for (int w = SORT_RUN; w < n; w *= 2)
+    {
+        for (int lo = 0; lo + w < n; lo += 2 * w)
+        {
+            merge(s, a + lo, w, n - lo < 2 * w ? n - lo : 2 * w, tmp);
+        }
+    }
+
+    free(tmp);
+}
+
+// ---------- Builtins ----------
+
+// Sort a List in ascending order. The sort is stable.
+// Accepts a List, and an optional comparator Function which returns true if its first argument comes before the second.
+// Without a comparator, elements must be all Numbers or all Strings.
+val *b_sort(env *e, val *v)
+{
+    ASSERT(v, v->d.exp.count == 1 || v->d.exp.count == 2,
+        "Function 'sort' passed incorrect number of arguments. Got %i, Expected 1 or 2.", v->d.exp.count);
+    ASSERT_TYPE("sort", v, 0, T_LST);
+
+    sorter s = {.e = e, .f = NULL, .less = NULL, .err = NULL};
+
+    if (v->d.exp.count == 2)
+    {
+        ASSERT_TYPE("sort", v, 1, T_FUN);
+        s.f = v->d.exp.list[1];
+
+        // Builtin '<' on Numbers is compared natively.
+        if (s.f->d.fun.blt == b_lt && native_less(v->d.exp.list[0]) != less_str)
+        {
+            s.less = native_less(v->d.exp.list[0]);
+        }
+    }
+    else
+    {
+        s.less = native_less(v->d.exp.list[0]);
+
+        ASSERT(v, s.less || v->d.exp.list[0]->d.exp.count == 0,
+            "Function 'sort' passed a List of mixed types. Expected all Numbers or all Strings, or a comparator Function.");
+    }
+
+    val *l = v->d.exp.list[0];
+    exp_own(l);
+    merge_sort(&s, l->d.exp.list, l->d.exp.count);
+
+    if (s.err)
+    {
+        free_val(v);
+        return s.err;
+    }
+
+    l = exp_pop(v, 0);
+    free_val(v);
+
+    return l;
+}
@@ -0,0 +1,8 @@
+#ifndef SORT_H
+#define SORT_H
+
+#include "types.h"
+
+val *b_sort(env *e, val *v);
+
+#endif
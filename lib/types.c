@@ -1,40 +1,78 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
+#include <time.h>
 
 #include "mpc.h"
 
 #include "types.h"
 #include "builtin.h"
+#include "interp.h"
+#include "map.h"
+#include "array.h"
+#include "seq.h"
+#include "bytes.h"
+#include "file.h"
+#include "site.h"
+#include "dispatch.h"
+#include "prof.h"
+#include "optimize.h"
 
 // ---------- Constructors ---------- 
 
 val *new_int(long n)
 {
-    val *v = malloc(sizeof(val));
+    val *v = val_alloc(T_INT);
     *v = (val){.type = T_INT, .d.intg = n};
     return v;
 }
 
 val *new_flt(double n)
 {
-    val *v = malloc(sizeof(val));
+    val *v = val_alloc(T_FLT);
     *v = (val){.type = T_FLT, .d.flt = n};
     return v;
 }
 
+// Set the text of a String or Error, in the val itself if short enough.
+static void str_init(val *v, char *s, size_t len)
+{
+    if (len <= STR_INLINE)
+    {
+        v->d.text.ptr = v->d.text.buf;
+    }
+    else
+    {
+        v->d.text.ptr = malloc(len + 1);
+        STAT_ADD(bytes, len + 1);
+    }
+
+    memcpy(v->d.text.ptr, s, len + 1);
+}
+
+static void str_free(val *v)
+{
+    if (v->d.text.ptr != v->d.text.buf)
+    {
+        free(v->d.text.ptr);
+    }
+}
+
 // Similar to printf formatting.
 val *new_err(char *format, ...)
 {
     va_list list;
     va_start(list, format);
 
-    val *v = malloc(sizeof(val));
-    *v = (val){.type = T_ERR, .d.str = malloc(512)};
+    char msg[512];
+    vsnprintf(msg, 511, format, list);
 
-    vsnprintf(v->d.str, 511, format, list);
-    v->d.str = realloc(v->d.str, strlen(v->d.str) + 1);
+    val *v = val_alloc(T_ERR);
+    v->type = T_ERR;
+    str_init(v, msg, strlen(msg));
 
     va_end(list);
 
@@ -43,54 +81,219 @@ val *new_err(char *format, ...)
 
 val *new_sym(char *s)
 {
-    val *v = malloc(sizeof(val));
-    *v = (val){.type = T_SYM, .d.str = malloc(strlen(s) + 1)};
-    strcpy(v->d.str, s);
+    site *st = site_new(s);
+
+    val *v = val_alloc(T_SYM);
+    *v = (val){.type = T_SYM, .d.sym = {.name = st->name, .site = st}};
     return v;
 }
 
 val *new_str(char *s)
 {
-    val *v = malloc(sizeof(val));
-    *v = (val){.type = T_STR, .d.str = malloc(strlen(s) + 1)};
-    strcpy(v->d.str, s);
+    val *v = val_alloc(T_STR);
+    v->type = T_STR;
+    str_init(v, s, strlen(s));
     return v;
 }
 
+// Append to the text of a String.
+void str_append(val *v, char *s)
+{
+    size_t len = strlen(v->d.str);
+    size_t add = strlen(s);
+
+    if (len + add > STR_INLINE && v->d.text.ptr == v->d.text.buf)
+    {
+        char *heap = malloc(len + add + 1);
+        memcpy(heap, v->d.text.buf, len + 1);
+        v->d.text.ptr = heap;
+    }
+    else if (len + add > STR_INLINE)
+    {
+        v->d.text.ptr = realloc(v->d.text.ptr, len + add + 1);
+    }
+
+    if (len + add > STR_INLINE)
+    {
+        STAT_ADD(bytes, add);
+    }
+
+    memcpy(v->d.text.ptr + len, s, add + 1);
+}
+
+// Elements of Expressions and Lists follow this header, which counts the vals sharing them.
+typedef struct
+{
+    int refs;
+    int cap;
+} exp_store;
+
+#define STORE(list) ((exp_store *)(list) - 1)
+
+static int exp_shared(val **list)
+{
+    return list && __atomic_load_n(&STORE(list)->refs, __ATOMIC_ACQUIRE) > 1;
+}
+
+// Free the elements of a List, timing it if large. Nested Lists are timed with the outermost.
+static void exp_free(val **list, int count)
+{
+    static __thread int timing = 0;
+    struct timespec start, end;
+
+    int timed = current_interp && count >= PAUSE_MIN && !timing;
+
+    if (timed)
+    {
+        timing = 1;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        free_val(list[i]);
+    }
+
+    free(STORE(list));
+
+    if (timed)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        stat_pause((end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+        timing = 0;
+    }
+}
+
+// Drop a reference to the elements of an Expression or List, freeing them with the last. Lists larger than
+// free_budget are queued instead, and freed by exp_sweep.
+static void exp_release(val **list, int count)
+{
+    if (list == NULL || __atomic_sub_fetch(&STORE(list)->refs, 1, __ATOMIC_ACQ_REL) > 0)
+    {
+        return;
+    }
+
+    interp *ip = current_interp;
+
+    if (ip == NULL || free_budget == 0 || count <= free_budget)
+    {
+        exp_free(list, count);
+        return;
+    }
+
+    sweeper *s = &ip->sweep;
+
+    if (s->count == s->cap)
+    {
+        s->cap = s->cap ? s->cap * 2 : 8;
+        s->items = realloc(s->items, sizeof(pending) * s->cap);
+    }
+
+    s->items[s->count++] = (pending){.list = list, .count = count};
+    ip->stats.deferred++;
+}
+
 val *new_exp(void)
 {
-    val *v = malloc(sizeof(val));
+    val *v = val_alloc(T_EXP);
     *v = (val){.type = T_EXP, .d.exp.count = 0, .d.exp.list = NULL};
     return v;
 }
 
 val *new_lst(void)
 {
-    val *v = new_exp();
-    v->type = T_LST;
+    val *v = val_alloc(T_LST);
+    *v = (val){.type = T_LST, .d.exp.count = 0, .d.exp.list = NULL};
     return v;
 }
 
 val *new_builtin_fun(builtin blt)
 {
-    val *v = malloc(sizeof(val));
-    *v = (val){.type = T_FUN, .d.fun.blt = blt};
+    val *v = val_alloc(T_FUN);
+    *v = (val){.type = T_FUN, .op = builtin_op(blt), .d.fun.blt = blt};
+
+#ifdef ZLISP_PROFILE
+    v->d.fun.prof = prof_intern(builtin_name(blt), 1);
+#endif
+
     return v;
 }
 
 val *new_fun(val *header, val *body)
 {
-    val *v = malloc(sizeof(val));
+    val *v = val_alloc(T_FUN);
     env *e = new_env();
     *v = (val){.type = T_FUN, .d.fun.blt = NULL, .d.fun.env = e, .d.fun.header = header, .d.fun.body = body};
     return v;
 }
 
+// Module values share the environment owned by the module registry.
+val *new_mod(char *path, env *e)
+{
+    val *v = val_alloc(T_MOD);
+    *v = (val){.type = T_MOD, .d.mod.path = malloc(strlen(path) + 1), .d.mod.env = e};
+    strcpy(v->d.mod.path, path);
+    return v;
+}
+
+val *new_map(void)
+{
+    val *v = val_alloc(T_MAP);
+    *v = (val){.type = T_MAP, .d.map = map_new()};
+    return v;
+}
+
+// Float (T_F64ARR) or Integer (T_I64ARR) Array of count elements. Elements must be filled before use.
+val *new_array(val_t type, int count)
+{
+    val *v = val_alloc(type);
+    *v = (val){.type = type, .d.arr = array_new(count, type == T_F64ARR ? sizeof(double) : sizeof(long))};
+    return v;
+}
+
+// Takes ownership of the Sequence node reference.
+val *new_seq(seq *s)
+{
+    val *v = val_alloc(T_SEQ);
+    *v = (val){.type = T_SEQ, .d.seq = s};
+    return v;
+}
+
+// View of len bytes of a backing store, from offset off. Takes ownership of the store reference.
+val *new_bytes(blob *b, long off, long len)
+{
+    val *v = val_alloc(T_BYTES);
+    *v = (val){.type = T_BYTES, .d.bytes.blob = b, .d.bytes.off = off, .d.bytes.len = len};
+    return v;
+}
+
+// Takes ownership of the handle reference.
+val *new_file(handle *h)
+{
+    val *v = val_alloc(T_FILE);
+    *v = (val){.type = T_FILE, .d.file = h};
+    return v;
+}
+
 env *new_env(void)
 {
     env *e = malloc(sizeof(env));
 
+    interp *ip = current_interp;
+    if (ip)
+    {
+        ip->stats.envs++;
+        ip->stats.bytes += sizeof(env);
+
+        if (++ip->stats.live_envs > ip->stats.peak_envs)
+        {
+            ip->stats.peak_envs = ip->stats.live_envs;
+        }
+    }
+
     e->parent = NULL;
+    e->module = 0;
+    e->ip = NULL;
     e->count = 0;
     e->keys = NULL;
     e->vals = NULL;
@@ -119,27 +322,48 @@ void free_val(val *v)
         break;
 
     case T_ERR:
-        free(v->d.str);
+        str_free(v);
         break;
     case T_SYM:
-        free(v->d.str);
+        site_free(v->d.sym.site);
         break;
 
     case T_STR:
-        free(v->d.str);
+        str_free(v);
+        break;
+
+    case T_MOD:
+        free(v->d.mod.path);
+        break;
+
+    case T_MAP:
+        map_free(v->d.map);
+        break;
+
+    case T_F64ARR:
+    case T_I64ARR:
+        array_free(v->d.arr);
+        break;
+
+    case T_SEQ:
+        seq_free(v->d.seq);
+        break;
+
+    case T_BYTES:
+        blob_free(v->d.bytes.blob);
+        break;
+
+    case T_FILE:
+        handle_free(v->d.file);
         break;
 
     case T_EXP:
     case T_LST:
-        for (int i = 0; i < v->d.exp.count; i++)
-        {
-            free_val(v->d.exp.list[i]);
-        }
-        free(v->d.exp.list);
+        exp_release(v->d.exp.list, v->d.exp.count);
         break;
     }
 
-    free(v);
+    val_release(v);
 }
 
 void free_env(env *e)
@@ -152,15 +376,19 @@ void free_env(env *e)
     free(e->keys);
     free(e->vals);
     free(e);
+
+    STAT_ADD(live_envs, -1);
 }
 
 // ---------- Copy ----------
 
 val *copy_val(val *v)
 {
-    val *c = malloc(sizeof(val));
+    val *c = val_alloc(v->type);
     c->type = v->type;
 
+    STAT_ADD(copies, 1);
+
     switch (v->type)
     {
     case T_INT:
@@ -171,6 +399,12 @@ val *copy_val(val *v)
         break;
 
     case T_FUN:
+#ifdef ZLISP_PROFILE
+        c->d.fun.prof = v->d.fun.prof;
+#endif
+
+        c->op = v->op;
+
         if (v->d.fun.blt)
         {
             c->d.fun.blt = v->d.fun.blt;
@@ -185,26 +419,52 @@ val *copy_val(val *v)
         break;
 
     case T_ERR:
-        c->d.str = malloc(strlen(v->d.str) + 1);
-        strcpy(c->d.str, v->d.str);
+        str_init(c, v->d.str, strlen(v->d.str));
         break;
 
     case T_SYM:
-        c->d.str = malloc(strlen(v->d.str) + 1);
-        strcpy(c->d.str, v->d.str);
+        c->d.sym = v->d.sym;
+        site_share(v->d.sym.site);
         break;
     case T_STR:
-        c->d.str = malloc(strlen(v->d.str) + 1);
-        strcpy(c->d.str, v->d.str);
+        str_init(c, v->d.str, strlen(v->d.str));
+        break;
+
+    case T_MOD:
+        c->d.mod.path = malloc(strlen(v->d.mod.path) + 1);
+        strcpy(c->d.mod.path, v->d.mod.path);
+        c->d.mod.env = v->d.mod.env;
+        break;
+
+    case T_MAP:
+        c->d.map = map_share(v->d.map);
+        break;
+
+    case T_F64ARR:
+    case T_I64ARR:
+        c->d.arr = array_share(v->d.arr);
         break;
 
+    case T_SEQ:
+        c->d.seq = seq_share(v->d.seq);
+        break;
+
+    case T_BYTES:
+        c->d.bytes = v->d.bytes;
+        blob_share(v->d.bytes.blob);
+        break;
+
+    case T_FILE:
+        c->d.file = handle_share(v->d.file);
+        break;
+
+    // Elements are shared, and only copied when either List is changed.
     case T_EXP:
     case T_LST:
-        c->d.exp.count = v->d.exp.count;
-        c->d.exp.list = malloc(sizeof(val *) * c->d.exp.count);
-        for (int i = 0; i < c->d.exp.count; i++)
+        c->d.exp = v->d.exp;
+        if (v->d.exp.list)
         {
-            c->d.exp.list[i] = copy_val(v->d.exp.list[i]);
+            __atomic_add_fetch(&STORE(v->d.exp.list)->refs, 1, __ATOMIC_RELAXED);
         }
         break;
     }
@@ -216,7 +476,10 @@ env *copy_env(env *e)
 {
     env *c = new_env();
 
+    STAT_ADD(env_copies, 1);
+
     c->parent = e->parent;
+    c->ip = e->ip;
 
     for (int i = 0; i < e->count; i++)
     {
@@ -226,7 +489,7 @@ env *copy_env(env *e)
     return c;
 }
 
-// ---------- Comparison ----------
+// ---------- Comparison, Hash ----------
 
 int val_eq(val *x, val *y)
 {
@@ -259,6 +522,25 @@ int val_eq(val *x, val *y)
             return val_eq(x->d.fun.header, y->d.fun.header) && val_eq(x->d.fun.body, y->d.fun.body);
         }
 
+    case T_MOD:
+        return x->d.mod.env == y->d.mod.env;
+
+    case T_MAP:
+        return map_eq(x->d.map, y->d.map);
+
+    case T_F64ARR:
+    case T_I64ARR:
+        return array_eq(x, y);
+
+    case T_SEQ:
+        return x->d.seq == y->d.seq;
+
+    case T_BYTES:
+        return bytes_eq(x, y);
+
+    case T_FILE:
+        return x->d.file == y->d.file;
+
     case T_LST:
     case T_EXP:
         if (x->d.exp.count != y->d.exp.count)
@@ -278,26 +560,189 @@ int val_eq(val *x, val *y)
     return 0;
 }
 
+// Hash consistent with val_eq: equal values have equal hashes.
+unsigned long val_hash(val *v)
+{
+    unsigned long h = 14695981039346656037UL ^ v->type;
+
+    switch (v->type)
+    {
+    case T_INT:
+        h ^= (unsigned long)v->d.intg;
+        break;
+    case T_FLT:
+    {
+        // 0.0 and -0.0 are equal.
+        double f = v->d.flt == 0 ? 0 : v->d.flt;
+        unsigned long bits;
+        memcpy(&bits, &f, sizeof(bits));
+        h ^= bits;
+        break;
+    }
+
+    case T_ERR:
+    case T_SYM:
+    case T_STR:
+        for (char *c = v->d.str; *c; c++)
+        {
+            h = (h ^ (unsigned char)*c) * 1099511628211UL;
+        }
+        break;
+
+    case T_FUN:
+        if (v->d.fun.blt)
+        {
+            h ^= (unsigned long)(size_t)v->d.fun.blt;
+        }
+        else
+        {
+            h ^= val_hash(v->d.fun.header) * 31 + val_hash(v->d.fun.body);
+        }
+        break;
+
+    case T_MOD:
+        h ^= (unsigned long)(size_t)v->d.mod.env;
+        break;
+
+    case T_MAP:
+        h ^= map_hash(v->d.map);
+        break;
+
+    case T_F64ARR:
+    case T_I64ARR:
+        h ^= array_hash(v);
+        break;
+
+    case T_SEQ:
+        h ^= (unsigned long)(size_t)v->d.seq;
+        break;
+
+    case T_BYTES:
+        h ^= bytes_hash(v);
+        break;
+
+    case T_FILE:
+        h ^= (unsigned long)(size_t)v->d.file;
+        break;
+
+    case T_LST:
+    case T_EXP:
+        for (int i = 0; i < v->d.exp.count; i++)
+        {
+            h = (h ^ val_hash(v->d.exp.list[i])) * 1099511628211UL;
+        }
+        break;
+    }
+
+    // Mix the bits, since table slots are taken from the low bits.
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdUL;
+    h ^= h >> 33;
+
+    return h;
+}
+
 // ---------- Environment - Get, Set ----------
 
-val *env_get(env *e, val *key)
+// Return the value of a Symbol without copying it, or NULL if unbound. Qualified Symbols are not searched.
+val *env_find(env *e, val *key)
 {
-    for (int i = 0; i < e->count; i++)
+    // Global definition found by an earlier lookup of the same Symbol.
+    interp *ip = current_interp;
+    val *cached = ip && key->type == T_SYM ? site_get(key->d.sym.site, ip->env) : NULL;
+
+    if (cached)
     {
-        if (strcmp(e->keys[i], key->d.str) == 0)
+        STAT_ADD(lookups, 1);
+        STAT_ADD(lookup_hits, 1);
+        return cached;
+    }
+
+    // Number of environments searched.
+    int depth = 0;
+
+    for (env *x = e; x; x = x->parent)
+    {
+        depth++;
+
+        for (int i = 0; i < x->count; i++)
         {
-            return copy_val(e->vals[i]);
+            if (strcmp(x->keys[i], key->d.str) == 0)
+            {
+                if (ip && x == ip->env && key->type == T_SYM)
+                {
+                    site_set(key->d.sym.site, x, i);
+                }
+
+                stat_lookup(depth);
+                return x->vals[i];
+            }
         }
     }
 
-    if (e->parent)
+    stat_lookup(depth);
+
+    return NULL;
+}
+
+val *env_get(env *e, val *key)
+{
+    val *x = env_find(e, key);
+
+    if (x)
     {
-        return env_get(e->parent, key);
+        return copy_val(x);
     }
-    else
+
+    // Qualified Symbol 'module/name'.
+    char *sep = strchr(key->d.str, '/');
+    if (sep && sep != key->d.str && sep[1] != '\0')
     {
-        return new_err("Unknown symbol '%s'.", key->d.str);
+        return env_get_qualified(e, key->d.str, sep);
     }
+
+    return new_err("Unknown symbol '%s'.", key->d.str);
+}
+
+// Get a definition from a module, by a Symbol in the form 'module/name'.
+val *env_get_qualified(env *e, char *key, char *sep)
+{
+    char *name = malloc(sep - key + 1);
+    memcpy(name, key, sep - key);
+    name[sep - key] = '\0';
+
+    val *sym = new_sym(name);
+    val *m = env_get(e, sym);
+    free_val(sym);
+    free(name);
+
+    if (m->type != T_MOD)
+    {
+        free_val(m);
+        return new_err("Unknown symbol '%s'.", key);
+    }
+
+    env *me = m->d.mod.env;
+    free_val(m);
+
+    // Only the module's own definitions are visible.
+    for (int i = 0; i < me->count; i++)
+    {
+        if (strcmp(me->keys[i], sep + 1) == 0)
+        {
+            val *v = copy_val(me->vals[i]);
+
+            // Functions resolve the module's other definitions when called from outside.
+            if (v->type == T_FUN && !v->d.fun.blt)
+            {
+                v->d.fun.env->parent = me;
+            }
+
+            return v;
+        }
+    }
+
+    return new_err("Unknown symbol '%s'. Not defined in module.", key);
 }
 
 void env_set(env *e, val *key, val *v)
@@ -312,6 +757,12 @@ void env_set(env *e, val *key, val *v)
         }
     }
 
+    // Names bound outside global environments can hide global definitions, so are no longer cached.
+    if (!e->ip)
+    {
+        site_shadow(key->d.str);
+    }
+
     e->count++;
     e->keys = realloc(e->keys, e->count * sizeof(char *));
     e->vals = realloc(e->vals, e->count * sizeof(val *));
@@ -322,10 +773,10 @@ void env_set(env *e, val *key, val *v)
     e->vals[e->count - 1] = copy_val(v);
 }
 
-// Set on the most parent environment.
+// Set on the most parent environment, or the module's environment if inside a module.
 void env_set_global(env *e, val *key, val *v)
 {
-    while (e->parent)
+    while (e->parent && !e->module)
     {
         e = e->parent;
     }
@@ -335,6 +786,46 @@ void env_set_global(env *e, val *key, val *v)
 // ---------- Print ----------
 
 char* val_to_str(val *v){
+    // Strings, Lists, Functions, Maps, Arrays, Sequences and Bytes can be of any length.
+    if (v->type == T_STR)
+    {
+        char *escaped = escape_str(v);
+        char *str = malloc(strlen(escaped) + 3);
+        sprintf(str, "\"%s\"", escaped);
+        free(escaped);
+        return str;
+    }
+    if (v->type == T_EXP || v->type == T_LST)
+    {
+        return exp_to_str(v);
+    }
+    if (v->type == T_FUN && !v->d.fun.blt)
+    {
+        char *header = val_to_str(v->d.fun.header);
+        char *body = val_to_str(v->d.fun.body);
+        char *str = malloc(strlen(header) + strlen(body) + 8);
+        sprintf(str, "(fun %s %s)", header, body);
+        free(header);
+        free(body);
+        return str;
+    }
+    if (v->type == T_MAP)
+    {
+        return map_to_str(v->d.map);
+    }
+    if (v->type == T_F64ARR || v->type == T_I64ARR)
+    {
+        return array_to_str(v);
+    }
+    if (v->type == T_SEQ)
+    {
+        return seq_to_str(v->d.seq);
+    }
+    if (v->type == T_BYTES)
+    {
+        return bytes_to_str(v);
+    }
+
     char* str = malloc(512);
 
     switch (v->type)
@@ -351,22 +842,23 @@ char* val_to_str(val *v){
     case T_SYM:
         snprintf(str, 511, "%s", v->d.str);
         break;
-    case T_STR:
-        snprintf(str, 511, "\"%s\"", escape_str(v));
+    case T_FUN:
+        snprintf(str, 511, "<%s>", builtin_name(v->d.fun.blt));
         break;
+    case T_MOD:
+        snprintf(str, 511, "<module %s>", v->d.mod.path);
+        break;
+    case T_FILE:
+        snprintf(str, 511, "<file %s>", v->d.file->path);
+        break;
+    case T_STR:
     case T_EXP:
     case T_LST:
-        snprintf(str, 511, "%s", exp_to_str(v));
-        break;
-    case T_FUN:
-        if (v->d.fun.blt)
-        {
-            snprintf(str, 511, "<%s>", builtin_name(v->d.fun.blt));
-        }
-        else
-        {
-            snprintf(str, 511, "(fun %s %s)", val_to_str(v->d.fun.header), val_to_str(v->d.fun.body));
-        }
+    case T_MAP:
+    case T_F64ARR:
+    case T_I64ARR:
+    case T_SEQ:
+    case T_BYTES:
         break;
     }
 
@@ -376,37 +868,49 @@ char* val_to_str(val *v){
 }
 
 char* exp_to_str(val *v){
-    char* str = malloc(512);
+    // Inlined calls print as written (see optimize.c).
+    if (v->d.exp.count == 4 && v->d.exp.list[0]->type == T_FUN && v->d.exp.list[0]->d.fun.blt == b_inlined)
+    {
+        char *call = exp_to_str(v->d.exp.list[3]);
+        call[0] = v->type == T_EXP ? '(' : '{';
+        call[strlen(call) - 1] = v->type == T_EXP ? ')' : '}';
+        return call;
+    }
+
+    // Grows as needed, since Lists can be of any length.
+    int cap = 512;
+    char* str = malloc(cap);
 
     int len = 0;
 
-    if (v->type == T_EXP)
-    {
-        len += snprintf(str+len, 511, "(");
-    } else {
-        len += snprintf(str+len, 511, "{");
-    }
+    str[len++] = v->type == T_EXP ? '(' : '{';
 
     for (int i = 0; i < v->d.exp.count; i++)
     {
         char* val_str = val_to_str(v->d.exp.list[i]);
+        int n = strlen(val_str);
+
+        if (len + n + 3 > cap)
+        {
+            cap = (len + n + 3) * 2;
+            str = realloc(str, cap);
+        }
+
+        memcpy(str + len, val_str, n);
+        len += n;
 
         if (i != (v->d.exp.count - 1))
         {
-            len += snprintf(str+len, 511, "%s ", val_str);
-        } else {
-            len += snprintf(str+len, 511, "%s", val_str);
+            str[len++] = ' ';
         }
-    }
 
-    if (v->type == T_EXP)
-    {
-        len += snprintf(str+len, 511, ")");
-    } else {
-        len += snprintf(str+len, 511, "}");
+        free(val_str);
     }
 
-    str = realloc(str, strlen(str) + 1);
+    str[len++] = v->type == T_EXP ? ')' : '}';
+    str[len] = '\0';
+
+    str = realloc(str, len + 1);
 
     return str;
 }
@@ -423,14 +927,27 @@ char* escape_str(val *v)
 
 void print_val(val *v)
 {
-    printf("%s", val_to_str(v));
+    fprint_val(stdout, v);
 }
 
 // Print with newline.
 void print_val_ln(val *v)
 {
-    print_val(v);
-    putchar('\n');
+    fprint_val_ln(stdout, v);
+}
+
+void fprint_val(FILE *f, val *v)
+{
+    char *str = val_to_str(v);
+    fputs(str, f);
+    free(str);
+}
+
+// Print to a file, with newline.
+void fprint_val_ln(FILE *f, val *v)
+{
+    fprint_val(f, v);
+    fputc('\n', f);
 }
 
 // ---------- Val - Type Name ----------
@@ -455,6 +972,20 @@ char *type_name(val_t type)
         return "List";
     case T_FUN:
         return "Function";
+    case T_MOD:
+        return "Module";
+    case T_MAP:
+        return "Map";
+    case T_F64ARR:
+        return "FloatArray";
+    case T_I64ARR:
+        return "IntegerArray";
+    case T_SEQ:
+        return "Sequence";
+    case T_BYTES:
+        return "Bytes";
+    case T_FILE:
+        return "File";
     default:
         return "Unknown";
     }
@@ -462,41 +993,132 @@ char *type_name(val_t type)
 
 // ---------- Expression/List - Add, Pop, Take, Join ----------
 
+// Make an Expression or List the only owner of its elements, copying them if shared. Must be called before
+// changing the elements or their number in place, which exp_add and exp_pop do.
+void exp_own(val *v)
+{
+    val **list = v->d.exp.list;
+
+    if (!exp_shared(list))
+    {
+        return;
+    }
+
+    exp_store *s = malloc(sizeof(exp_store) + sizeof(val *) * v->d.exp.count);
+    *s = (exp_store){.refs = 1, .cap = v->d.exp.count};
+    STAT_ADD(bytes, sizeof(exp_store) + sizeof(val *) * v->d.exp.count);
+    STAT_ADD(list_copies, 1);
+
+    v->d.exp.list = (val **)(s + 1);
+
+    for (int i = 0; i < v->d.exp.count; i++)
+    {
+        v->d.exp.list[i] = copy_val(list[i]);
+    }
+
+    exp_release(list, v->d.exp.count);
+}
+
+// Make room for at least cap elements, owned by the Expression or List. Grows by doubling, so adding is
+// amortized O(1).
+void exp_reserve(val *v, int cap)
+{
+    exp_own(v);
+
+    exp_store *s = v->d.exp.list ? STORE(v->d.exp.list) : NULL;
+    int old = s ? s->cap : 0;
+
+    if (cap <= old)
+    {
+        return;
+    }
+
+    cap = cap > old * 2 ? cap : old * 2;
+
+    s = realloc(s, sizeof(exp_store) + sizeof(val *) * cap);
+    *s = (exp_store){.refs = 1, .cap = cap};
+    STAT_ADD(bytes, sizeof(val *) * (cap - old) + (old ? 0 : sizeof(exp_store)));
+
+    v->d.exp.list = (val **)(s + 1);
+}
+
 val *exp_add(val *v, val *child)
 {
-    v->d.exp.count++;
-    v->d.exp.list = realloc(v->d.exp.list, sizeof(val *) * v->d.exp.count);
-    v->d.exp.list[v->d.exp.count - 1] = child;
+    exp_reserve(v, v->d.exp.count + 1);
+    v->d.exp.list[v->d.exp.count++] = child;
     return v;
 }
 
 val *exp_pop(val *v, int i)
 {
+    exp_own(v);
+
     val *x = v->d.exp.list[i];
 
     memmove(&v->d.exp.list[i], &v->d.exp.list[i + 1], sizeof(val *) * (v->d.exp.count - i - 1));
 
     v->d.exp.count--;
 
-    v->d.exp.list = realloc(v->d.exp.list, sizeof(val *) * v->d.exp.count);
-
     return x;
 }
 
+// Pop an element and free the rest. Elements still shared are not copied, only the one taken.
 val *exp_take(val *v, int i)
 {
-    val *x = exp_pop(v, i);
+    val *x;
+
+    if (exp_shared(v->d.exp.list))
+    {
+        x = copy_val(v->d.exp.list[i]);
+    }
+    else
+    {
+        x = v->d.exp.list[i];
+        v->d.exp.list[i] = v->d.exp.list[--v->d.exp.count];
+    }
 
     free_val(v);
 
     return x;
 }
 
+// Free up to n elements of the Lists queued by exp_release. Elements which are large Lists are queued in turn,
+// and freed first.
+void exp_sweep(interp *ip, int n)
+{
+    sweeper *s = &ip->sweep;
+
+    while (n-- > 0 && s->count)
+    {
+        pending *p = &s->items[s->count - 1];
+
+        if (p->count == 0)
+        {
+            free(STORE(p->list));
+            s->count--;
+            continue;
+        }
+
+        // May queue another List, moving the items.
+        free_val(p->list[--p->count]);
+    }
+}
+
+// Move the elements of y to the end of x, or copy them if shared, and free y.
 val *exp_join(val *x, val *y)
 {
-    while (y->d.exp.count)
+    int shared = exp_shared(y->d.exp.list);
+
+    exp_reserve(x, x->d.exp.count + y->d.exp.count);
+
+    for (int i = 0; i < y->d.exp.count; i++)
+    {
+        x->d.exp.list[x->d.exp.count++] = shared ? copy_val(y->d.exp.list[i]) : y->d.exp.list[i];
+    }
+
+    if (!shared)
     {
-        exp_add(x, exp_pop(y, 0));
+        y->d.exp.count = 0;
     }
 
     free_val(y);
@@ -505,7 +1127,30 @@ val *exp_join(val *x, val *y)
 
 // ---------- Function - Call ----------
 
+#ifdef ZLISP_PROFILE
+static val *call_fun(env *e, val *first, val *v);
+
+// Count and time the call while profiling.
 val *call(env *e, val *first, val *v)
+{
+    if (!prof_enabled)
+    {
+        return call_fun(e, first, v);
+    }
+
+    int id = first->d.fun.prof;
+
+    prof_enter(id);
+    val *r = call_fun(e, first, v);
+    prof_leave(id);
+
+    return r;
+}
+
+static val *call_fun(env *e, val *first, val *v)
+#else
+val *call(env *e, val *first, val *v)
+#endif
 {
     // If builtin function, call it directly.
     if (first->d.fun.blt)
@@ -579,7 +1224,11 @@ val *call(env *e, val *first, val *v)
     // If all parameters are filled, evaluate the function.
     if (first->d.fun.header->d.exp.count == 0)
     {
-        first->d.fun.env->parent = e;
+        // Functions taken from a module already have the module as parent.
+        if (!first->d.fun.env->parent)
+        {
+            first->d.fun.env->parent = e;
+        }
 
         return b_eval(first->d.fun.env, exp_add(new_exp(), copy_val(first->d.fun.body)));
     }
@@ -613,7 +1262,14 @@ val *eval(env *e, val *v)
 
 val *eval_exp(env *e, val *v)
 {   
-    // Evaluate all children.
+    // Inlined calls choose their code without evaluating the rest (see optimize.c).
+    if (v->d.exp.count == 4 && v->d.exp.list[0]->type == T_FUN && v->d.exp.list[0]->d.fun.blt == b_inlined)
+    {
+        return eval(e, inlined_code(e, v, 1));
+    }
+
+    // Evaluate all children, in place.
+    exp_own(v);
     for (int i = 0; i < v->d.exp.count; i++)
     {
         v->d.exp.list[i] = eval(e, v->d.exp.list[i]);
@@ -640,8 +1296,20 @@ val *eval_exp(env *e, val *v)
         return exp_take(v, 0);
     }
     
+    // Call core builtins directly on the children, if their arguments allow.
+    val *first = v->d.exp.list[0];
+    if (first->type == T_FUN && first->op != OP_NONE && !prof_enabled)
+    {
+        val *r = dispatch(first->op, v);
+
+        if (r)
+        {
+            return r;
+        }
+    }
+
     // Ensure first child is a function.
-    val *first = exp_pop(v, 0);
+    first = exp_pop(v, 0);
     if (first->type != T_FUN)
     {
         val *err = new_err("Expression must start with a Function. Received '%s'.", type_name(first->type));
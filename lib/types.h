@@ -1,6 +1,8 @@
 #ifndef TYPES_H
 #define TYPES_H
 
+#include <stdio.h>
+
 typedef enum
 {
     T_INT, // Integer
@@ -10,18 +12,45 @@ typedef enum
     T_STR, // String
     T_EXP, // Expression
     T_LST, // List
-    T_FUN  // Function
+    T_FUN, // Function
+    T_MOD, // Module
+    T_MAP,    // Map
+    T_F64ARR, // Float Array
+    T_I64ARR, // Integer Array
+    T_SEQ,    // Sequence
+    T_BYTES,  // Bytes
+    T_FILE    // File
 } val_t;
 
+// Number of types. Follows the last type.
+#define TYPE_COUNT (T_FILE + 1)
+
 struct val;
 union val_data;
 struct env;
+struct interp;
+struct map;
+struct array;
+struct seq;
+struct blob;
+struct handle;
+struct site;
 typedef struct val val;
 typedef union val_data val_data;
 typedef struct env env;
+typedef struct interp interp;
+typedef struct map map;
+typedef struct array array;
+typedef struct seq seq;
+typedef struct blob blob;
+typedef struct handle handle;
+typedef struct site site;
 
 typedef val *(*builtin)(env *, val *);
 
+// Longest text of Strings and Errors stored in the val itself. Longer texts are allocated separately.
+#define STR_INLINE 23
+
 union val_data
 {
     long intg;
@@ -29,25 +58,70 @@ union val_data
     
     char *str;
 
+    // Strings and Errors. 'ptr' is also read as 'str', and points to 'buf' if the text is at most STR_INLINE long.
+    struct
+    {
+        char *ptr;
+        char buf[STR_INLINE + 1];
+    } text;
+
+    // Symbol. 'name' is also read as 'str', and belongs to 'site', shared by all copies of the Symbol (see site.h).
+    struct
+    {
+        char *name;
+        site *site;
+    } sym;
+
     struct
     {
         builtin blt;
         env *env;
         val *header;
         val *body;
+
+#ifdef ZLISP_PROFILE
+        // Profile entry, see prof.h.
+        int prof;
+#endif
     } fun;
     
+    // Expressions and Lists. 'list' is shared by copies until one of them is changed, see exp_own.
     struct
     {
         int count;
         val **list;
     } exp;
+
+    struct
+    {
+        char *path;
+        env *env;
+    } mod;
+
+    map *map;
+
+    array *arr;
+
+    seq *seq;
+
+    struct
+    {
+        blob *blob;
+        long off;
+        long len;
+    } bytes;
+
+    handle *file;
 };
 
 struct val
 {
     val_t type;
 
+    // Functions: operator of builtins with a fast path in eval_exp (see dispatch.h), or OP_NONE.
+    // Kept here rather than in 'd', where it would make every val larger.
+    int op;
+
     val_data d;
 };
 
@@ -55,6 +129,12 @@ struct env
 {
     env *parent;
 
+    // Module root environment. Global definitions ('def') made inside a module stop here.
+    int module;
+
+    // Interpreter owning the environment. Only set on the global environment.
+    interp *ip;
+
     int count;
     char **keys;
     val **vals;
@@ -72,6 +152,8 @@ val *new_sym(char *s);
 
 val *new_str(char *s);
 
+void str_append(val *v, char *s);
+
 val *new_exp(void);
 
 val *new_lst(void);
@@ -80,6 +162,18 @@ val *new_builtin_fun(builtin blt);
 
 val *new_fun(val *header, val *body);
 
+val *new_mod(char *path, env *e);
+
+val *new_map(void);
+
+val *new_array(val_t type, int count);
+
+val *new_seq(seq *s);
+
+val *new_bytes(blob *b, long off, long len);
+
+val *new_file(handle *h);
+
 env *new_env(void);
 
 // ---------- Destructors ----------
@@ -94,14 +188,20 @@ val *copy_val(val *v);
 
 env *copy_env(env *e);
 
-// ---------- Comparison ----------
+// ---------- Comparison, Hash ----------
 
 int val_eq(val *x, val *y);
 
+unsigned long val_hash(val *v);
+
 // ---------- Environment - Get, Set ----------
 
+val *env_find(env *e, val *key);
+
 val *env_get(env *e, val *key);
 
+val *env_get_qualified(env *e, char *key, char *sep);
+
 void env_set(env *e, val *key, val *v);
 
 void env_set_global(env *e, val *key, val *v);
@@ -118,12 +218,20 @@ void print_val(val *v);
 
 void print_val_ln(val *v);
 
+void fprint_val(FILE *f, val *v);
+
+void fprint_val_ln(FILE *f, val *v);
+
 // ---------- Val - Type Name ----------
 
 char *type_name(val_t type);
 
 // ---------- Expression/List - Add, Pop, Take, Join ----------
 
+void exp_own(val *v);
+
+void exp_reserve(val *v, int cap);
+
 val *exp_add(val *v, val *child);
 
 val *exp_pop(val *v, int i);
@@ -132,6 +240,8 @@ val *exp_take(val *v, int i);
 
 val *exp_join(val *x, val *y);
 
+void exp_sweep(interp *ip, int n);
+
 // ---------- Function - Call ----------
 
 val *call(env *e, val *first, val *v);
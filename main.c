@@ -1,13 +1,14 @@
-// gcc -std=c99 -Wall -Werror -o zlisp main.c mpc.c types.c builtin.c parser.c -ledit -lm
+// gcc -std=c99 -Wall -Werror -o zlisp main.c mpc.c types.c builtin.c parser.c cache.c interp.c pool.c parallel.c map.c array.c simd.c sort.c seq.c bytes.c file.c csv.c json.c prof.c compile.c optimize.c site.c dispatch.c -ledit -lm -lpthread
 
 #define VERSION "0.1.0"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 
 #ifdef _WIN32
 // Implementation for Windows, replacing editline/readline functions.
-#include <string.h>
 
 static char buffer[2048];
 
@@ -33,48 +34,228 @@ void add_history(char *unused) {}
 #include "lib/types.h"
 #include "lib/builtin.h"
 #include "lib/parser.h"
+#include "lib/cache.h"
+#include "lib/interp.h"
+#include "lib/pool.h"
+#include "lib/prof.h"
+#include "lib/compile.h"
+#include "lib/optimize.h"
+
+// Scripts run by '--parallel', and their outputs waiting to be written in order.
+typedef struct
+{
+    interp *base;
+    char **files;
+
+    interp **done;
+    int next;
+    pthread_mutex_t lock;
+} batch;
+
+// Run one script on its own copy of the base interpreter, then write all finished outputs that are next in order.
+void run_script(void *ctx, int i)
+{
+    batch *b = ctx;
+
+    interp *ip = copy_interp(b->base);
+    interp_capture(ip);
+
+    val *x = interp_load(ip, b->files[i]);
+
+    // Print error if any.
+    if (x->type == T_ERR)
+    {
+        fprint_val_ln(ip->out, x);
+    }
+
+    free_val(x);
 
-// Define parsers variables.
-mpc_parser_t *Number;
-mpc_parser_t *String;
-mpc_parser_t *Symbol;
-mpc_parser_t *Expression;
-mpc_parser_t *List;
-mpc_parser_t *Component;
-mpc_parser_t *Comment;
-mpc_parser_t *Parser;
+    pthread_mutex_lock(&b->lock);
+
+    b->done[i] = ip;
+
+    while (b->done[b->next])
+    {
+        size_t len;
+        char *out = interp_output(b->done[b->next], &len);
+        fwrite(out, 1, len, stdout);
+
+        free_interp(b->done[b->next]);
+        b->next++;
+    }
+
+    pthread_mutex_unlock(&b->lock);
+}
+
+// Interpreter whose statistics are printed at exit, with '--stats'.
+static interp *stats_ip = NULL;
+
+#ifdef ZLISP_PROFILE
+// Destination of the profile JSON, with '--profile-json'. Otherwise, a table is printed with '--profile'.
+static char *profile_json = NULL;
+#endif
+
+// Print the profile and statistics, if enabled. Also runs on 'exit'.
+void print_exit_reports(void)
+{
+#ifdef ZLISP_PROFILE
+    if (prof_enabled)
+    {
+        fflush(stdout);
+        prof_enabled = 0;
+
+        FILE *f = profile_json ? fopen(profile_json, "w") : stderr;
+
+        if (f == NULL)
+        {
+            fprintf(stderr, "Unable to write profile to '%s'.\n", profile_json);
+        }
+        else if (profile_json)
+        {
+            prof_print_json(f);
+            fclose(f);
+        }
+        else
+        {
+            prof_print_table(f);
+        }
+    }
+#endif
+
+    if (stats_ip)
+    {
+        fflush(stdout);
+        fprint_stats(stderr, &stats_ip->stats);
+        stats_ip = NULL;
+    }
+}
+
+// Run a command of the interactive prompt, starting with ',': ',time EXPR' or ',alloc EXPR' evaluate EXPR and report
+// its cost after the result.
+void run_command(interp *ip, char *input)
+{
+    char *expr = strchr(input, ' ');
+    size_t len = expr ? (size_t)(expr - input) : strlen(input);
+
+    int time = len == 5 && strncmp(input, ",time", len) == 0;
+    int alloc = len == 6 && strncmp(input, ",alloc", len) == 0;
+
+    if (!time && !alloc)
+    {
+        printf("Unknown command '%.*s'. Expected ',time EXPR' or ',alloc EXPR'.\n", (int)len, input);
+        return;
+    }
+
+    cost c;
+    val *x = interp_eval_cost(ip, expr ? expr + 1 : "", &c);
+    print_val_ln(x);
+    free_val(x);
+
+    if (time)
+    {
+        fprint_time(stdout, &c);
+    }
+    else
+    {
+        fprint_alloc(stdout, &c);
+    }
+}
 
 int main(int argc, char **argv)
 {
     // Create parsers.
-    Number = mpc_new("number");
-    String = mpc_new("string");
-    Symbol = mpc_new("symbol");
-    Expression = mpc_new("expression");
-    List = mpc_new("list");
-    Component = mpc_new("component");
-    Comment = mpc_new("comment");
-    Parser = mpc_new("parser");
-
-    // Define parsers rules.
-    mpca_lang(MPCA_LANG_DEFAULT,
-    "                                                                                       \
-        number      : /-?[0-9]+\\.?[0-9]*/ ;                                                \
-        string      : /\"(\\\\.|[^\"])*\"/ ;                                                \
-        symbol      : /[a-zA-Z0-9|^%_+\\-*\\/\\\\=<>!&]+/ ;                                  \
-        expression  : '(' <component>* ')' ;                                                \
-        list        : '{' <component>* '}' ;                                                \
-        component   : <number> | <string> | <symbol> | <expression> | <list> | <comment> ;  \
-        comment     : /;[^\\r\\n]*/ ;                                                       \
-        parser      : /^/ <component>* /$/ ;                                                \
-    ", Number, String, Symbol, Expression, List, Component, Comment, Parser);
-
-    // Initialize global environment.
-    env *e = new_env();
-    add_builtins(e);
+    grammar *g = new_grammar();
+
+    // Module cache directory, from environment. Overridden by '--cache-dir'.
+    cache_set_dir(getenv("ZLISP_CACHE_DIR"));
+
+    // Apply options, and keep file names in argv[1..files].
+    int files = 0;
+    int parallel = 0;
+    int show_stats = 0;
+    char *compile_path = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--cache-dir") == 0 && i + 1 < argc)
+        {
+            cache_set_dir(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--parallel") == 0 && i + 1 < argc)
+        {
+            parallel = atoi(argv[++i]);
+
+            if (parallel < 1)
+            {
+                fprintf(stderr, "Option '--parallel' expects a positive number of threads.\n");
+                return EXIT_FAILURE;
+            }
+        }
+        else if (strcmp(argv[i], "--free-budget") == 0 && i + 1 < argc)
+        {
+            free_budget = atoi(argv[++i]);
+
+            if (free_budget < 1)
+            {
+                fprintf(stderr, "Option '--free-budget' expects a positive number of elements.\n");
+                return EXIT_FAILURE;
+            }
+        }
+        else if (strcmp(argv[i], "--compile-c") == 0 && i + 1 < argc)
+        {
+            compile_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--no-opt") == 0)
+        {
+            opt_enabled = 0;
+        }
+        else if (strcmp(argv[i], "--stats") == 0)
+        {
+            show_stats = 1;
+        }
+        else if (strcmp(argv[i], "--profile") == 0 || (strcmp(argv[i], "--profile-json") == 0 && i + 1 < argc))
+        {
+#ifdef ZLISP_PROFILE
+            prof_enabled = 1;
+            profile_json = strcmp(argv[i], "--profile-json") == 0 ? argv[++i] : NULL;
+#else
+            fprintf(stderr, "Option '%s' needs a build with profiling ('make profile').\n", argv[i]);
+            return EXIT_FAILURE;
+#endif
+        }
+        else
+        {
+            argv[++files] = argv[i];
+        }
+    }
+
+    // With '--compile-c', write the file translated to C, and exit.
+    if (compile_path)
+    {
+        val *x = compile_c(compile_path, g->parser, stdout);
+        int failed = x->type == T_ERR;
+
+        if (failed)
+        {
+            fprint_val_ln(stderr, x);
+        }
+
+        free_val(x);
+        free_grammar(g);
+
+        return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    // Initialize interpreter, and its global environment.
+    interp *ip = new_interp(g->parser);
+
+    if (show_stats)
+    {
+        stats_ip = ip;
+    }
+    atexit(print_exit_reports);
 
     // Load standard library.
-    val *std = b_load(e, exp_add(new_exp(), new_str("std.zsp")));
+    val *std = interp_load(ip, "std.zsp");
 
     // Print error if occurred during loading.
     if (std->type == T_ERR)
@@ -86,13 +267,22 @@ int main(int argc, char **argv)
 
     // Check if arugments are passed,
     // Accepts file names as arguments, and load/run them sequentially, then exit.
-    if (argc > 1)
+    // With '--parallel', each file runs on its own copy of the environment, and outputs are written in order.
+    if (files > 0 && parallel > 0)
     {
-        for (int i = 1; i < argc; i++)
-        {
-            val *args = exp_add(new_exp(), new_str(argv[i]));
+        batch b = {.base = ip, .files = argv + 1, .done = calloc(files + 1, sizeof(interp *)), .next = 0};
+        pthread_mutex_init(&b.lock, NULL);
+
+        pool_for(parallel, files, run_script, &b);
 
-            val *x = b_load(e, args);
+        pthread_mutex_destroy(&b.lock);
+        free(b.done);
+    }
+    else if (files > 0)
+    {
+        for (int i = 1; i <= files; i++)
+        {
+            val *x = interp_load(ip, argv[i]);
 
             // Print error if any.
             if (x->type == T_ERR)
@@ -106,7 +296,8 @@ int main(int argc, char **argv)
     else // If no arguments are passed, run interactive prompt.
     {
         puts("Z-Lisp, v: " VERSION);
-        puts("Press Ctrl-C to Exit\n");
+        puts("Press Ctrl-C to Exit");
+        puts("Prefix an expression with ',time' or ',alloc' to measure it\n");
 
         while (1)
         {
@@ -114,10 +305,14 @@ int main(int argc, char **argv)
 
             add_history(input);
 
-            if (input[0] != '\0')
+            if (input[0] == ',')
+            {
+                run_command(ip, input);
+            }
+            else if (input[0] != '\0')
             {
                 // Parse input, evalute, and return val result.
-                val* x = parse(input, Parser, e);
+                val* x = interp_eval(ip, input);
                 print_val_ln(x);
             }
 
@@ -125,7 +320,10 @@ int main(int argc, char **argv)
         }
     }
 
+    print_exit_reports();
+
     // Cleanup.
-    free_env(e);
-    mpc_cleanup(8, Number, String, Symbol, Expression, List, Component, Comment, Parser);
+    free_interp(ip);
+    free_grammar(g);
+    cache_set_dir(NULL);
 }